@@ -1,6 +1,26 @@
 find_program(GLSLC_COMMAND glslc)
 find_program(SPIRV_CROSS_COMMAND spirv-cross)
 
+# sigma-bake writes the files each bake actually read to a depfile, when the
+# generator supports them every asset only depends on what it references.
+if(CMAKE_GENERATOR MATCHES "Ninja" OR (CMAKE_GENERATOR MATCHES "Makefiles" AND NOT CMAKE_VERSION VERSION_LESS 3.20))
+    set(SIGMA_BAKE_DEPFILES ON)
+endif()
+
+option(SIGMA_BAKE_PROFILE "Write a Chrome trace of every bake to sigma-bake/profile" OFF)
+
+# Prints the cost summary over the traces of every package in the build.
+if(SIGMA_BAKE_PROFILE AND NOT TARGET sigma-bake-profile)
+    add_custom_target(sigma-bake-profile
+        COMMAND sigma-bake --profile-summary "${CMAKE_BINARY_DIR}/sigma-bake/profile"
+        USES_TERMINAL
+    )
+endif()
+
+if(POLICY CMP0116)
+    cmake_policy(SET CMP0116 NEW)
+endif()
+
 function(list_filter_extension LIST_VAR)
     list(GET ARGN 0 FLITER_REGEX)
     list(REMOVE_ITEM ARGN ${FLITER_REGEX})
@@ -15,8 +35,59 @@ function(list_filter_extension LIST_VAR)
     set(${LIST_VAR} ${TMP_LIST} PARENT_SCOPE)
 endfunction()
 
-function(add_package PACKAGE_NAME)
+# With BYPRODUCTS, OUTPUT is a stamp sigma-bake touches on every run while
+# the byproducts are only rewritten when their content changed. Ninja restats
+# byproducts, so whatever depends on them only rebuilds on a real change.
+function(add_bake_command OUTPUT)
     set(options)
+    set(oneValueArgs WORKING_DIRECTORY)
+    set(multiValueArgs SOURCES ARGS DEPENDS FALLBACK_DEPENDS EXTRA_OUTPUTS BYPRODUCTS)
+    cmake_parse_arguments(add_bake_command "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
+
+    if(add_bake_command_BYPRODUCTS)
+        list(GET add_bake_command_BYPRODUCTS 0 BAKE_OUTPUT)
+        list(APPEND add_bake_command_ARGS --stamp "${OUTPUT}")
+    else()
+        set(BAKE_OUTPUT "${OUTPUT}")
+    endif()
+
+    file(RELATIVE_PATH BAKE_OUTPUT_NAME "${CMAKE_BINARY_DIR}/data" "${BAKE_OUTPUT}")
+
+    if(SIGMA_BAKE_PROFILE)
+        list(APPEND add_bake_command_ARGS --profile "${CMAKE_BINARY_DIR}/sigma-bake/profile/${BAKE_OUTPUT_NAME}.json")
+    endif()
+
+    if(SIGMA_BAKE_DEPFILES)
+        set(BAKE_DEPFILE "${CMAKE_BINARY_DIR}/sigma-bake/depfiles/${BAKE_OUTPUT_NAME}.d")
+
+        add_custom_command(
+            OUTPUT ${OUTPUT} ${add_bake_command_EXTRA_OUTPUTS}
+            BYPRODUCTS ${add_bake_command_BYPRODUCTS}
+            COMMAND sigma-bake -o "${CMAKE_BINARY_DIR}" --depfile "${BAKE_DEPFILE}" ${add_bake_command_ARGS} ${add_bake_command_SOURCES}
+            DEPENDS ${add_bake_command_SOURCES} ${add_bake_command_DEPENDS}
+            DEPFILE "${BAKE_DEPFILE}"
+            WORKING_DIRECTORY ${add_bake_command_WORKING_DIRECTORY}
+        )
+    else()
+        add_custom_command(
+            OUTPUT ${OUTPUT} ${add_bake_command_EXTRA_OUTPUTS}
+            BYPRODUCTS ${add_bake_command_BYPRODUCTS}
+            COMMAND sigma-bake -o "${CMAKE_BINARY_DIR}" ${add_bake_command_ARGS} ${add_bake_command_SOURCES}
+            DEPENDS ${add_bake_command_SOURCES} ${add_bake_command_DEPENDS} ${add_bake_command_FALLBACK_DEPENDS}
+            WORKING_DIRECTORY ${add_bake_command_WORKING_DIRECTORY}
+        )
+    endif()
+endfunction()
+
+# POSITION_STREAMS also bakes a position only vertex stream for every static
+# mesh to data/position_stream, for depth and shadow passes.
+#
+# Identical textures are baked once and copied from sigma-bake/content in the
+# output directory. The copies only share their storage on file systems with
+# copy on write (Btrfs, XFS), elsewhere they are full copies that only save
+# the bake time. Content no texture was stored from any more is removed.
+function(add_package PACKAGE_NAME)
+    set(options POSITION_STREAMS)
     set(oneValueArgs PACKAGE_ROOT)
     set(multiValueArgs)
     cmake_parse_arguments(add_package "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
@@ -80,10 +151,9 @@ function(add_package PACKAGE_NAME)
             DEPENDS "${SHADER_OUTPUT}${SHADER_EXT}_spv"
         )
 
-        add_custom_command(
-            OUTPUT "${SHADER_OUTPUT}"
-            COMMAND sigma-bake -o "${CMAKE_BINARY_DIR}" "${SHADER_OUTPUT}${SHADER_EXT}_spv"
-            DEPENDS "${SHADER_OUTPUT}${SHADER_EXT}_spv" "${SHADER_OUTPUT}${SHADER_EXT}_spv.json"
+        add_bake_command("${SHADER_OUTPUT}"
+            SOURCES "${SHADER_OUTPUT}${SHADER_EXT}_spv"
+            DEPENDS "${SHADER_OUTPUT}${SHADER_EXT}_spv.json"
             WORKING_DIRECTORY "${CMAKE_BINARY_DIR}/data/shader"
         )
 
@@ -113,9 +183,8 @@ function(add_package PACKAGE_NAME)
             set(TEXTURE_DEPENDS "${TEXTURE}" "${TEXTURE_SETTINGS}")
         endif()
 
-        add_custom_command(
-            OUTPUT ${TEXTURE_OUTPUT}
-            COMMAND sigma-bake -o "${CMAKE_BINARY_DIR}" "${TEXTURE}"
+        add_bake_command(${TEXTURE_OUTPUT}
+            SOURCES "${TEXTURE}"
             DEPENDS ${TEXTURE_DEPENDS}
             WORKING_DIRECTORY ${add_package_PACKAGE_ROOT}
         )
@@ -140,20 +209,36 @@ function(add_package PACKAGE_NAME)
         set(MATERIAL "${add_package_PACKAGE_ROOT}/${MATERIAL}")
         set(MATERIAL_OUTPUT "${CMAKE_BINARY_DIR}/data/material/${MATERIAL_DIRECTORY}${MATERIAL_NAME}")
 
-        # TODO: make this smarter
-        set(MATERIAL_DEPENDS "${MATERIAL}" ${SHADER_OUTPUTS} ${TEXTURE_OUTPUTS})
-
-        add_custom_command(
-            OUTPUT ${MATERIAL_OUTPUT}
-            COMMAND sigma-bake -o "${CMAKE_BINARY_DIR}" "${MATERIAL}"
-            DEPENDS ${MATERIAL_DEPENDS}
+        add_bake_command(${MATERIAL_OUTPUT}
+            SOURCES "${MATERIAL}"
+            FALLBACK_DEPENDS ${SHADER_OUTPUTS} ${TEXTURE_OUTPUTS}
             WORKING_DIRECTORY ${add_package_PACKAGE_ROOT}
         )
 
+        list(APPEND MATERIAL_SOURCES ${MATERIAL})
         list(APPEND MATERIAL_OUTPUTS ${MATERIAL_OUTPUT})
     endforeach()
 
+    # Package material index, collapses duplicate materials into aliases
+    if(MATERIAL_SOURCES)
+        set(MATERIAL_INDEX "${CMAKE_BINARY_DIR}/data/${PACKAGE_NAME}.material_index")
+        set(MATERIAL_INDEX_STAMP "${CMAKE_BINARY_DIR}/sigma-bake/stamps/${PACKAGE_NAME}.material_index")
+        set(MATERIAL_INDEX_ARGS --material-index "${MATERIAL_INDEX}")
+
+        add_bake_command(${MATERIAL_INDEX_STAMP}
+            SOURCES ${MATERIAL_SOURCES}
+            ARGS ${MATERIAL_INDEX_ARGS}
+            BYPRODUCTS ${MATERIAL_INDEX}
+            FALLBACK_DEPENDS ${SHADER_OUTPUTS}
+            WORKING_DIRECTORY ${add_package_PACKAGE_ROOT}
+        )
+    endif()
+
     #Package static meshes
+    if(add_package_POSITION_STREAMS)
+        set(STATIC_MESH_ARGS --position-streams)
+    endif()
+
     set(STATIC_MESH_SOURCE_FILES "${add_package_UNPARSED_ARGUMENTS}")
     list_filter_extension(STATIC_MESH_SOURCE_FILES
         3ds dae fbx ifc-step ase dxf hmp md2 md3 md5 mdc mdl nff ply stl x obj
@@ -172,18 +257,38 @@ function(add_package PACKAGE_NAME)
         set(STATIC_MESH "${add_package_PACKAGE_ROOT}/${STATIC_MESH}")
         set(STATIC_MESH_OUTPUT "${CMAKE_BINARY_DIR}/data/static_mesh/${STATIC_MESH_DIRECTORY}${STATIC_MESH_NAME}")
 
-        # TODO: make this smarter
-        set(STATIC_MESH_DEPENDS "${STATIC_MESH}" ${SHADER_OUTPUTS} ${TEXTURE_OUTPUTS} ${MATERIAL_OUTPUTS})
+        set(POSITION_STREAM_OUTPUT)
+        if(add_package_POSITION_STREAMS)
+            set(POSITION_STREAM_OUTPUT "${CMAKE_BINARY_DIR}/data/position_stream/${STATIC_MESH_DIRECTORY}${STATIC_MESH_NAME}")
+        endif()
 
-        add_custom_command(
-            OUTPUT ${STATIC_MESH_OUTPUT}
-            COMMAND sigma-bake -o "${CMAKE_BINARY_DIR}" "${STATIC_MESH}"
-            DEPENDS ${STATIC_MESH_DEPENDS}
+        add_bake_command(${STATIC_MESH_OUTPUT}
+            SOURCES "${STATIC_MESH}"
+            ARGS ${MATERIAL_INDEX_ARGS} ${STATIC_MESH_ARGS}
+            EXTRA_OUTPUTS ${POSITION_STREAM_OUTPUT}
+            DEPENDS ${MATERIAL_INDEX}
+            FALLBACK_DEPENDS ${SHADER_OUTPUTS} ${TEXTURE_OUTPUTS} ${MATERIAL_OUTPUTS}
             WORKING_DIRECTORY ${add_package_PACKAGE_ROOT}
         )
 
         list(APPEND STATIC_MESH_OUTPUTS ${STATIC_MESH_OUTPUT})
     endforeach()
 
-   add_custom_target(${PACKAGE_NAME} DEPENDS ${SHADER_OUTPUTS} ${TEXTURE_OUTPUTS} ${MATERIAL_OUTPUTS} ${STATIC_MESH_OUTPUTS})
+    # Depfiles only know about dependencies after the first bake, the stage
+    # targets make sure everything an asset can reference is baked first.
+    add_custom_target(${PACKAGE_NAME}-shaders DEPENDS ${SHADER_OUTPUTS})
+    add_custom_target(${PACKAGE_NAME}-textures DEPENDS ${TEXTURE_OUTPUTS})
+
+    add_custom_target(${PACKAGE_NAME}-materials DEPENDS ${MATERIAL_OUTPUTS} ${MATERIAL_INDEX_STAMP})
+    add_dependencies(${PACKAGE_NAME}-materials ${PACKAGE_NAME}-shaders ${PACKAGE_NAME}-textures)
+
+    add_custom_target(${PACKAGE_NAME}-static-meshes DEPENDS ${STATIC_MESH_OUTPUTS})
+    add_dependencies(${PACKAGE_NAME}-static-meshes ${PACKAGE_NAME}-materials)
+
+    add_custom_target(${PACKAGE_NAME})
+    add_dependencies(${PACKAGE_NAME} ${PACKAGE_NAME}-static-meshes)
+
+    if(SIGMA_BAKE_PROFILE)
+        add_dependencies(sigma-bake-profile ${PACKAGE_NAME})
+    endif()
 endfunction()
@@ -0,0 +1,165 @@
+#include "synthetic_assets.hpp"
+
+#include "bake.hpp"
+#include "profiler.hpp"
+
+#include <sigma/context.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace {
+// Generated inputs are kept between runs in the system temp directory, the
+// large meshes take a while to write. The generator version keeps inputs of
+// older generators from being reused.
+std::filesystem::path source_directory()
+{
+    static const auto path = std::filesystem::temp_directory_path() / "sigma-bake-benchmark" / ("source-v" + std::to_string(synthetic::version));
+    std::filesystem::create_directories(path);
+    return path;
+}
+
+// Baked resources are not kept, every run starts from an empty output and
+// bakes the prerequisites with the code being measured.
+std::filesystem::path output_directory()
+{
+    static const auto path = []() {
+        auto path = std::filesystem::temp_directory_path() / "sigma-bake-benchmark" / "output";
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+        return path;
+    }();
+    return path;
+}
+
+// Every iteration bakes into a fresh context so nothing is served from the
+// cache of the previous one.
+template <class Baker>
+void run_bake(benchmark::State& state, const std::filesystem::path& source_path, Baker baker)
+{
+    profiler profile;
+    for (auto _ : state) {
+        state.PauseTiming();
+        // Identical content would only be linked from the second iteration on.
+        std::filesystem::remove_all(output_directory() / "sigma-bake" / "content");
+        auto context = std::make_shared<sigma::context>(output_directory());
+        bake_job job;
+        job.output_directory = output_directory();
+        job.profile = &profile;
+        profile.begin_asset(source_path.string());
+        state.ResumeTiming();
+
+        baker(context, job, source_directory(), source_path);
+        job.flush();
+
+        state.PauseTiming();
+        profile.end_asset(0, 0);
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * std::filesystem::file_size(source_path)));
+    for (const auto& [stage, time] : profile.stage_totals())
+        state.counters[stage] = benchmark::Counter(std::chrono::duration<double>(time).count(), benchmark::Counter::kAvgIterations);
+}
+
+std::filesystem::path prepare_shader(std::size_t array_size)
+{
+    auto spirv_path = source_directory() / "vertex" / ("bench_" + std::to_string(array_size) + ".vert_spv");
+    if (!std::filesystem::exists(spirv_path))
+        synthetic::write_shader(spirv_path, array_size);
+
+    static std::set<std::size_t> baked;
+    if (baked.insert(array_size).second) {
+        bake_job job;
+        job.output_directory = output_directory();
+        bake_shader(std::make_shared<sigma::context>(output_directory()), job, source_directory(), spirv_path);
+        job.flush();
+    }
+    return spirv_path;
+}
+
+std::filesystem::path prepare_material(std::size_t array_size)
+{
+    prepare_shader(array_size);
+
+    auto material_path = source_directory() / ("bench_" + std::to_string(array_size) + ".smat");
+    if (!std::filesystem::exists(material_path))
+        synthetic::write_material(material_path, "bench_" + std::to_string(array_size), array_size);
+
+    static std::set<std::size_t> baked;
+    if (baked.insert(array_size).second) {
+        bake_job job;
+        job.output_directory = output_directory();
+        bake_material(std::make_shared<sigma::context>(output_directory()), job, source_directory(), material_path);
+        job.flush();
+    }
+    return material_path;
+}
+
+// AUTO sets "automatic_format", letting the pixel analysis pick the format.
+const char* texture_formats[] = { "RGB8", "RGBA8", "RGB32F", "AUTO" };
+}
+
+static void BM_bake_texture(benchmark::State& state)
+{
+    auto size = static_cast<int>(state.range(0));
+    std::string format = texture_formats[state.range(1)];
+    state.SetLabel(format);
+
+    auto image_path = source_directory() / ("texture_" + std::to_string(size) + "_" + format + ".ppm");
+    if (!std::filesystem::exists(image_path)) {
+        synthetic::write_image(image_path, size);
+        synthetic::write_texture_settings(image_path, format);
+    }
+
+    run_bake(state, image_path, bake_texture);
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_bake_texture)
+    ->ArgsProduct({ { 256, 1024, 4096 }, { 0, 1, 2, 3 } })
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_bake_shader(benchmark::State& state)
+{
+    auto array_size = static_cast<std::size_t>(state.range(0));
+    run_bake(state, prepare_shader(array_size), bake_shader);
+}
+BENCHMARK(BM_bake_shader)
+    ->RangeMultiplier(16)
+    ->Range(16, 4096)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_bake_material(benchmark::State& state)
+{
+    auto array_size = static_cast<std::size_t>(state.range(0));
+    run_bake(state, prepare_material(array_size), bake_material);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(array_size));
+}
+BENCHMARK(BM_bake_material)
+    ->RangeMultiplier(16)
+    ->Range(16, 4096)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_bake_mesh(benchmark::State& state)
+{
+    auto triangle_count = static_cast<std::size_t>(state.range(0));
+    prepare_material(16);
+
+    auto mesh_path = source_directory() / ("mesh_" + std::to_string(triangle_count) + ".obj");
+    if (!std::filesystem::exists(mesh_path))
+        synthetic::write_mesh(mesh_path, triangle_count, "bench_16");
+
+    run_bake(state, mesh_path, bake_mesh);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(triangle_count));
+}
+BENCHMARK(BM_bake_mesh)
+    ->RangeMultiplier(10)
+    ->Range(1000, 10000000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
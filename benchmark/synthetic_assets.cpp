@@ -0,0 +1,111 @@
+#include "synthetic_assets.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace synthetic {
+
+void write_image(const std::filesystem::path& path, int size)
+{
+    std::mt19937 random { 1337 };
+    std::uniform_int_distribution<int> noise { -16, 16 };
+
+    std::vector<unsigned char> pixels(static_cast<std::size_t>(size) * size * 3);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            auto pixel = &pixels[(static_cast<std::size_t>(y) * size + x) * 3];
+            pixel[0] = static_cast<unsigned char>(std::clamp(x * 255 / size + noise(random), 0, 255));
+            pixel[1] = static_cast<unsigned char>(std::clamp(y * 255 / size + noise(random), 0, 255));
+            pixel[2] = static_cast<unsigned char>(std::clamp(128 + noise(random), 0, 255));
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n"
+         << size << ' ' << size << "\n255\n";
+    file.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+}
+
+void write_texture_settings(const std::filesystem::path& image_path, const std::string& format)
+{
+    auto settings_path = image_path.parent_path() / (image_path.stem().string() + ".stex");
+    std::ofstream file(settings_path);
+    if (format == "AUTO")
+        file << nlohmann::json { { "automatic_format", true } }.dump(4);
+    else
+        file << nlohmann::json { { "format", format } }.dump(4);
+}
+
+void write_shader(const std::filesystem::path& spirv_path, std::size_t array_size)
+{
+    std::filesystem::create_directories(spirv_path.parent_path());
+
+    // The bakers never look inside the SPIR-V, only its size matters.
+    std::vector<char> spirv(16 * 1024);
+    std::mt19937 random { 1337 };
+    for (auto& byte : spirv)
+        byte = static_cast<char>(random());
+    std::ofstream source(spirv_path, std::ios::binary);
+    source.write(spirv.data(), static_cast<std::streamsize>(spirv.size()));
+
+    nlohmann::json j_reflection = {
+        { "types", { { "_bench", { { "name", "bench" }, { "members", { { { "name", "values" }, { "type", "vec4" }, { "array", { array_size } }, { "offset", 0 } } } } } } } },
+        { "ubos", { { { "type", "_bench" }, { "name", "bench" }, { "block_size", array_size * 16 }, { "set", 0 }, { "binding", 0 } } } }
+    };
+    std::ofstream reflection(spirv_path.string() + ".json");
+    reflection << j_reflection.dump(4);
+}
+
+void write_material(const std::filesystem::path& path, const std::string& shader_name, std::size_t array_size)
+{
+    nlohmann::json j_values = nlohmann::json::array();
+    for (std::size_t i = 0; i < array_size; ++i) {
+        float v = static_cast<float>(i) / static_cast<float>(array_size);
+        j_values.push_back({ v, 1.0f - v, v * v, 1.0f });
+    }
+
+    std::ofstream file(path);
+    file << nlohmann::json { { "vertex", shader_name }, { "values", j_values } }.dump(4);
+}
+
+void write_mesh(const std::filesystem::path& path, std::size_t triangle_count, const std::string& material_name)
+{
+    auto material_path = path.parent_path() / (path.stem().string() + ".mtl");
+    {
+        std::ofstream file(material_path);
+        file << "newmtl " << material_name << '\n';
+    }
+
+    // A w x w quad grid has 2 w^2 triangles.
+    auto width = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(triangle_count) / 2.0)));
+
+    std::ofstream file(path);
+    file << "mtllib " << material_path.filename().string() << '\n';
+    for (std::size_t y = 0; y <= width; ++y) {
+        for (std::size_t x = 0; x <= width; ++x) {
+            float u = static_cast<float>(x) / static_cast<float>(width);
+            float v = static_cast<float>(y) / static_cast<float>(width);
+            file << "v " << u << ' ' << 0.1f * std::sin(u * 20.0f) * std::cos(v * 20.0f) << ' ' << v << '\n';
+            file << "vt " << u << ' ' << v << '\n';
+        }
+    }
+    file << "vn 0 1 0\n";
+    file << "usemtl " << material_name << '\n';
+
+    // OBJ indices are 1 based.
+    auto index = [width](std::size_t x, std::size_t y) { return y * (width + 1) + x + 1; };
+    for (std::size_t y = 0; y < width; ++y) {
+        for (std::size_t x = 0; x < width; ++x) {
+            auto a = index(x, y), b = index(x + 1, y), c = index(x + 1, y + 1), d = index(x, y + 1);
+            file << "f " << a << '/' << a << "/1 " << b << '/' << b << "/1 " << c << '/' << c << "/1\n";
+            file << "f " << a << '/' << a << "/1 " << c << '/' << c << "/1 " << d << '/' << d << "/1\n";
+        }
+    }
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef SIGMA_BAKE_SYNTHETIC_ASSETS_HPP
+#define SIGMA_BAKE_SYNTHETIC_ASSETS_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+// Generators for the benchmark inputs, all output is deterministic so
+// results stay comparable across commits.
+namespace synthetic {
+
+// Bump whenever a generator writes different output, generated inputs are
+// kept in a directory named after it.
+constexpr int version = 2;
+
+// Binary PPM of size x size pixels, a gradient with noise on top.
+void write_image(const std::filesystem::path& path, int size);
+
+// .stex next to an image selecting the texture format (RGB8, RGBA8, ...),
+// AUTO lets the baker pick it from the pixels.
+void write_texture_settings(const std::filesystem::path& image_path, const std::string& format);
+
+// SPIR-V stand-in plus spirv-cross style reflection data for a vertex
+// shader with a single UBO holding an array of array_size vec4s.
+void write_shader(const std::filesystem::path& spirv_path, std::size_t array_size);
+
+// Material using shader_name as vertex shader, filling the UBO array.
+void write_material(const std::filesystem::path& path, const std::string& shader_name, std::size_t array_size);
+
+// OBJ grid with at least triangle_count triangles using material_name.
+void write_mesh(const std::filesystem::path& path, std::size_t triangle_count, const std::string& material_name);
+
+}
+
+#endif // SIGMA_BAKE_SYNTHETIC_ASSETS_HPP
@@ -0,0 +1,246 @@
+#include "bake.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+std::string escape_depfile_path(const std::filesystem::path& path)
+{
+    std::string escaped;
+    for (char c : path.generic_string()) {
+        if (c == ' ' || c == '#' || c == '\\')
+            escaped += '\\';
+        else if (c == '$')
+            escaped += '$';
+        escaped += c;
+    }
+    return escaped;
+}
+
+std::string unique_suffix()
+{
+    std::random_device random;
+    std::ostringstream suffix;
+    suffix << std::hex << random() << random();
+    return suffix.str();
+}
+}
+
+std::filesystem::path bake_job::resource_path(const std::string& type, const sigma::resource::key_type& key) const
+{
+    return output_directory / "data" / type / key;
+}
+
+void bake_job::produces(const std::string& type, const sigma::resource::key_type& key)
+{
+    outputs.push_back(resource_path(type, key));
+    if (profile)
+        profile->set_asset_type(type);
+}
+
+profiler::scope bake_job::stage(std::string name)
+{
+    return profiler::scope(profile, std::move(name));
+}
+
+void bake_job::depends_on(const std::filesystem::path& path)
+{
+    auto absolute_path = std::filesystem::absolute(path).lexically_normal();
+    if (std::find(dependencies.begin(), dependencies.end(), absolute_path) == dependencies.end())
+        dependencies.push_back(absolute_path);
+}
+
+void bake_job::write_file(const std::string& type, const sigma::resource::key_type& key, std::vector<char> data)
+{
+    auto output_path = resource_path(type, key).lexically_relative(output_directory);
+    writes.push_back([output_path, data = std::move(data)](const std::shared_ptr<sigma::context>&, const std::filesystem::path& root) {
+        auto path = root / output_path;
+        std::filesystem::create_directories(path.parent_path());
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file)
+            throw std::runtime_error("Could not write '" + path.string() + "'");
+    });
+    written.push_back(resource_path(type, key));
+}
+
+std::filesystem::path bake_job::content_path(const std::string& type, const std::string& hash) const
+{
+    return std::filesystem::path("sigma-bake") / "content" / type / hash;
+}
+
+bool bake_job::link_content(const std::string& type, const sigma::resource::key_type& key, const std::string& hash)
+{
+    auto stored_path = content_path(type, hash);
+    auto output_path = resource_path(type, key).lexically_relative(output_directory);
+
+    if (stored_content.count(stored_path)) {
+        auto output_directory = this->output_directory;
+        writes.push_back([output_path, stored_path, output_directory](const std::shared_ptr<sigma::context>&, const std::filesystem::path& root) {
+            // Content stored earlier in the same batch has not been published yet.
+            auto source = root / stored_path;
+            if (!std::filesystem::exists(source))
+                source = output_directory / stored_path;
+            clone_file(source, root / output_path);
+        });
+    } else {
+        // Content of earlier runs is pinned by a link of its own until it is
+        // copied, prune_content in a concurrent bake only removes content
+        // nothing else links to. Without hard links it is baked again.
+        auto pin_path = output_directory / stored_path;
+        pin_path += ".pin-" + unique_suffix();
+        std::error_code ec;
+        std::filesystem::create_hard_link(output_directory / stored_path, pin_path, ec);
+        if (ec)
+            return false;
+
+        writes.push_back([output_path, pin_path](const std::shared_ptr<sigma::context>&, const std::filesystem::path& root) {
+            clone_file(pin_path, root / output_path);
+            std::filesystem::remove(pin_path);
+        });
+    }
+    replaces_content(type, key);
+    written.push_back(resource_path(type, key));
+    return true;
+}
+
+void bake_job::prune_content() const
+{
+    for (const auto& type : replaced_content) {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(output_directory / "sigma-bake" / "content" / type, ec)) {
+            // Pins of concurrent bakes are left alone, only content hashes
+            // have no extension.
+            if (entry.path().has_extension())
+                continue;
+            if (entry.is_regular_file(ec) && entry.hard_link_count(ec) == 1)
+                std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+void bake_job::replaces_content(const std::string& type, const sigma::resource::key_type& key)
+{
+    // Outputs that store content are hard links to it, copies are not.
+    std::error_code ec;
+    auto links = std::filesystem::hard_link_count(resource_path(type, key), ec);
+    if (!ec && links > 1)
+        replaced_content.insert(type);
+}
+
+void bake_job::reads(const std::filesystem::path& path)
+{
+    depends_on(path);
+
+    auto absolute_path = std::filesystem::absolute(path).lexically_normal();
+    if (std::find(inputs.begin(), inputs.end(), absolute_path) == inputs.end())
+        inputs.push_back(absolute_path);
+}
+
+void bake_job::flush()
+{
+    if (writes.empty())
+        return;
+
+    auto write = stage("write");
+    if (writer) {
+        writer->push(std::move(writes));
+        pending.insert(written.begin(), written.end());
+
+        // Profiled runs wait for the write, so its time and the size of the
+        // outputs are counted for the asset that produced them.
+        if (profile) {
+            writer->wait();
+            pending.clear();
+        }
+    } else {
+        auto context = std::make_shared<sigma::context>(output_directory);
+        for (const auto& write_resource : writes)
+            write_resource(context, output_directory);
+    }
+    writes.clear();
+    written.clear();
+}
+
+void bake_job::wait_for(const std::filesystem::path& path)
+{
+    if (writer && pending.count(path)) {
+        writer->wait();
+        pending.clear();
+    }
+}
+
+void bake_job::link_file(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+    std::filesystem::create_directories(target.parent_path());
+
+    // Link next to the target and rename over it, so the target is replaced
+    // in one step.
+    auto temporary_path = target;
+    temporary_path += ".link";
+    std::filesystem::remove(temporary_path);
+
+    std::error_code ec;
+    std::filesystem::create_hard_link(source, temporary_path, ec);
+    if (ec)
+        std::filesystem::copy_file(source, temporary_path);
+    std::filesystem::rename(temporary_path, target);
+}
+
+void bake_job::clone_file(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+    std::filesystem::create_directories(target.parent_path());
+
+    auto temporary_path = target;
+    temporary_path += ".clone";
+    std::filesystem::remove(temporary_path);
+
+    bool cloned = false;
+#ifdef __linux__
+    // A reflink on file systems with copy on write (Btrfs, XFS), the data
+    // is still only stored once.
+    int source_fd = ::open(source.c_str(), O_RDONLY);
+    if (source_fd >= 0) {
+        int target_fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (target_fd >= 0) {
+            cloned = ::ioctl(target_fd, FICLONE, source_fd) == 0;
+            ::close(target_fd);
+        }
+        ::close(source_fd);
+    }
+#endif
+    if (!cloned)
+        std::filesystem::copy_file(source, temporary_path, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::rename(temporary_path, target);
+}
+
+void bake_job::write_depfile(const std::filesystem::path& path) const
+{
+    if (outputs.empty())
+        return;
+
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+
+    std::ofstream file(path);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (i != 0)
+            file << ' ';
+        file << escape_depfile_path(outputs[i].lexically_normal());
+    }
+    file << ':';
+    for (const auto& dependency : dependencies)
+        file << " \\\n  " << escape_depfile_path(dependency);
+    file << '\n';
+}
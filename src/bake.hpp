@@ -0,0 +1,199 @@
+#ifndef SIGMA_BAKE_BAKE_HPP
+#define SIGMA_BAKE_BAKE_HPP
+
+#include "output_writer.hpp"
+#include "profiler.hpp"
+
+#include <sigma/context.hpp>
+#include <sigma/resource/cache.hpp>
+
+#include <any>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <set>
+#include <string>
+#include <vector>
+
+struct bake_job {
+    // Root of the baked resource tree (the -o option).
+    std::filesystem::path output_directory;
+
+    // Package material index used to resolve material aliases.
+    std::filesystem::path material_index;
+
+    // Fully load dependencies instead of only referencing them.
+    bool load_dependencies = false;
+
+    // Also bake a position only vertex stream for every static mesh.
+    bool position_streams = false;
+
+    // Transient allocations of the bake, released once it finished.
+    std::pmr::memory_resource* memory = std::pmr::new_delete_resource();
+
+    // Set when running with --profile.
+    profiler* profile = nullptr;
+
+    // Writes the baked resources in the background, without one they are
+    // written directly once the bake is flushed.
+    output_writer* writer = nullptr;
+
+    // Resources to write once the bake finished.
+    std::vector<write_function> writes;
+
+    // Files produced and read by the bake, written out as a depfile.
+    std::vector<std::filesystem::path> outputs;
+    std::vector<std::filesystem::path> dependencies;
+
+    // Dependencies whose content the current asset actually read, the ones
+    // only referenced by key are left out. Cleared for every asset of a
+    // batch so shared dependencies count for each asset reading them.
+    std::vector<std::filesystem::path> inputs;
+
+    // Path of the baked resource of the given type (shader, texture, ...).
+    std::filesystem::path resource_path(const std::string& type, const sigma::resource::key_type& key) const;
+
+    void produces(const std::string& type, const sigma::resource::key_type& key);
+
+    // Times a stage of the bake until the returned scope is destroyed.
+    profiler::scope stage(std::string name);
+
+    void depends_on(const std::filesystem::path& path);
+
+    // Records a dependency the bake reads.
+    void reads(const std::filesystem::path& path);
+
+    // Loads a resource through its cache and records the baked file it
+    // came from as a dependency.
+    template <class Cache>
+    auto get(const Cache& cache, const std::string& type, const sigma::resource::key_type& key)
+    {
+        auto path = resource_path(type, key);
+        wait_for(path);
+        reads(path);
+        return cache->get(key);
+    }
+
+    // Resolves a dependency by key only, the baked file has to exist but is
+    // never loaded. A stand-in made by make_reference is inserted in the
+    // cache (without writing it) so the resource being baked can still hold
+    // a handle to it. Falls back to get() if there is no baked file, as for
+    // resources built into the engine.
+    template <class Cache, class Factory>
+    auto reference(const Cache& cache, const std::string& type, const sigma::resource::key_type& key, Factory make_reference)
+    {
+        auto path = resource_path(type, key);
+        wait_for(path);
+        if (load_dependencies || !std::filesystem::exists(path))
+            return get(cache, type, key);
+
+        depends_on(path);
+
+        using handle_type = decltype(cache->get(key));
+        auto it = references.find(path);
+        if (it != references.end())
+            return std::any_cast<handle_type>(it->second);
+
+        handle_type handle = cache->insert(key, make_reference(), false);
+        references[path] = handle;
+        return handle;
+    }
+
+    // Queues the resource to be written to disk when the bake is flushed.
+    template <class Resource>
+    void write(const std::string& type, const sigma::resource::key_type& key, std::shared_ptr<Resource> resource)
+    {
+        writes.push_back([key, resource](const std::shared_ptr<sigma::context>& context, const std::filesystem::path&) {
+            context->cache<Resource>()->insert(key, resource, true);
+        });
+        written.push_back(resource_path(type, key));
+    }
+
+    // Queues data that is not a sigma resource to be written as the baked
+    // file of the given type.
+    void write_file(const std::string& type, const sigma::resource::key_type& key, std::vector<char> data);
+
+    // Path below the output directory under which baked content with the
+    // given hash is kept, a hard link to the first resource baked from it.
+    // The store is not a build output, so sharing the modification time of
+    // that resource does not matter. Once that resource is replaced the
+    // content is pruned.
+    std::filesystem::path content_path(const std::string& type, const std::string& hash) const;
+
+    // Writes the resource like write() and stores it under its content hash
+    // so later bakes of identical content can link to it.
+    template <class Resource>
+    void write_content(const std::string& type, const sigma::resource::key_type& key, const std::string& hash, std::shared_ptr<Resource> resource)
+    {
+        replaces_content(type, key);
+        auto output_path = resource_path(type, key).lexically_relative(output_directory);
+        auto stored_path = content_path(type, hash);
+        writes.push_back([key, resource, output_path, stored_path](const std::shared_ptr<sigma::context>& context, const std::filesystem::path& root) {
+            // The output may be a link to stored content, never write through it.
+            std::filesystem::remove(root / output_path);
+            context->cache<Resource>()->insert(key, resource, true);
+            link_file(root / output_path, root / stored_path);
+        });
+        written.push_back(resource_path(type, key));
+        stored_content.insert(stored_path);
+    }
+
+    // Queues a copy of content stored by an earlier bake as the resource,
+    // returns false if there is none and the resource has to be written.
+    bool link_content(const std::string& type, const sigma::resource::key_type& key, const std::string& hash);
+
+    // Hands the queued writes to the writer, or writes them right away.
+    void flush();
+
+    // Removes stored content that no output links to any more, after this
+    // job replaced an output it was stored from. Needs everything written.
+    void prune_content() const;
+
+    // Writes a Make/Ninja style depfile listing every output and dependency.
+    void write_depfile(const std::filesystem::path& path) const;
+
+private:
+    // Waits for the writer if path is still queued, the file on disk may
+    // be left over from an earlier run.
+    void wait_for(const std::filesystem::path& path);
+
+    // Notes the type if the current output of the resource is linked to
+    // stored content, replacing the output leaves that content unused.
+    void replaces_content(const std::string& type, const sigma::resource::key_type& key);
+
+    // Replaces target with a hard link to source (a copy where the file
+    // system has no hard links).
+    static void link_file(const std::filesystem::path& source, const std::filesystem::path& target);
+
+    // Replaces target with a copy of source that shares its data blocks
+    // where the file system supports it. Unlike a hard link the copy is a
+    // file of its own, with the time it was made as modification time.
+    static void clone_file(const std::filesystem::path& source, const std::filesystem::path& target);
+
+    std::map<std::filesystem::path, std::any> references;
+
+    // Outputs of the writes queued since the last flush.
+    std::vector<std::filesystem::path> written;
+
+    // Outputs handed to the writer that may not be published yet.
+    std::set<std::filesystem::path> pending;
+
+    // Content stored by this job, it may not have reached the output yet.
+    std::set<std::filesystem::path> stored_content;
+
+    // Types of which this job replaced outputs that stored content.
+    std::set<std::string> replaced_content;
+};
+
+void bake_texture(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
+
+void bake_shader(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
+
+void bake_material(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
+
+void bake_mesh(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
+
+void index_materials(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::vector<std::filesystem::path>& source_paths);
+
+#endif // SIGMA_BAKE_BAKE_HPP
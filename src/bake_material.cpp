@@ -1,21 +1,29 @@
+#include "bake.hpp"
 #include "glm_json.hpp"
+#include "material_index.hpp"
+#include "content_hash.hpp"
+#include "transient_json.hpp"
 
 #include <sigma/context.hpp>
 #include <sigma/graphics/material.hpp>
 #include <sigma/resource/cache.hpp>
 #include <sigma/util/filesystem.hpp>
 
-#include <nlohmann/json.hpp>
-
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <set>
+#include <stdexcept>
+
+static const std::set<std::string> material_shader_keys = {
+    "vertex", "tessellation_control", "tessellation_evaluation", "geometry", "fragment"
+};
 
 namespace sigma {
 namespace graphics {
 
-    void from_json(const nlohmann::json& j, buffer& b)
+    void from_json(const transient_json& j, buffer& b)
     {
         const auto& schema = b.schema();
         for (const auto& item : j.items()) {
@@ -106,12 +114,8 @@ namespace graphics {
         }
     }
 
-    void from_json(const nlohmann::json& j, material& mat)
+    void from_json(const transient_json& j, material& mat, bake_job& job)
     {
-        static const std::set<std::string> shader_keys = {
-            "vertex", "tessellation_control", "tessellation_evaluation", "geometry", "fragment"
-        };
-
         if (auto ctx = mat.context().lock()) {
             auto shader_cache = ctx->cache<shader>();
             auto buffer_cache = ctx->cache<buffer>();
@@ -119,9 +123,9 @@ namespace graphics {
 
             for (const auto& item : j.items()) {
                 auto key = item.key();
-                if (shader_keys.count(key)) {
+                if (material_shader_keys.count(key)) {
                     auto shader_key = key / sigma::resource::key_type(item.value().get<std::string>());
-                    auto shader = shader_cache->get(shader_key);
+                    auto shader = job.get(shader_cache, "shader", shader_key);
 
                     const auto& shader_schema = shader->schema();
 
@@ -130,8 +134,10 @@ namespace graphics {
                         resource::handle_type<buffer> buffer = mat.buffer(buff_schema.binding_point);
                         if (!buffer) {
                             resource::key_type buffer_key = mat.key() / buff_schema.name;
-                            buffer = buffer_cache->insert(buffer_key, std::make_shared<graphics::buffer>(mat.context(), buffer_key, buff_schema));
+                            auto new_buffer = std::make_shared<graphics::buffer>(mat.context(), buffer_key, buff_schema);
+                            buffer = buffer_cache->insert(buffer_key, new_buffer);
                             mat.set_buffer(buff_schema.binding_point, buffer);
+                            job.write("buffer", buffer_key, new_buffer);
                         } else if (!buffer->merge(buff_schema)) {
                             throw std::runtime_error("Buffer schema miss-match in material: " + mat.key().string());
                         }
@@ -152,8 +158,15 @@ namespace graphics {
                 if (key == "textures") {
                     for (const auto& texture_j : value.items()) {
                         size_t index;
-                        if (mat.texture_binding_point(texture_j.key(), index))
-                            mat.set_texture(index, texture_cache->get(texture_j.value().get<std::string>()));
+                        if (!mat.texture_binding_point(texture_j.key(), index))
+                            continue;
+
+                        // The material only stores a handle, so the pixel data is never loaded.
+                        resource::key_type texture_key = texture_j.value().get<std::string>();
+                        mat.set_texture(index, job.reference(texture_cache, "texture", texture_key, [&]() {
+                            image_t<rgb8_pixel_t> image;
+                            return std::make_shared<texture>(ctx, texture_key, image, texture_filter::LINEAR, texture_filter::LINEAR, texture_filter::LINEAR);
+                        }));
                     }
                 } else if (key == "cubemaps") {
                     // TODO: cubemaps
@@ -167,22 +180,109 @@ namespace graphics {
 }
 }
 
-void bake_material(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
+void bake_material(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
 {
     auto key = sigma::filesystem::make_relative(source_directory, source_path).replace_extension("");
-    auto material_cache = context->cache<sigma::graphics::material>();
-    auto buffer_cache = context->cache<sigma::graphics::buffer>();
 
-    nlohmann::json j_material;
-    std::ifstream file(source_path);
-    file >> j_material;
+    job.produces("material", key);
+    job.reads(source_path);
+
+    transient_json j_material;
+    {
+        auto parse = job.stage("parse");
+        std::ifstream file(source_path);
+        file >> j_material;
+    }
 
     auto material = std::make_shared<sigma::graphics::material>(context, key);
-    from_json(j_material, *material);
+    {
+        auto convert = job.stage("convert");
+        from_json(j_material, *material, job);
+    }
+
+    job.write("material", key, material);
+}
+
+void index_materials(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::vector<std::filesystem::path>& source_paths)
+{
+    auto shader_cache = context->cache<sigma::graphics::shader>();
+
+    // Sort by key so the canonical material of a set of duplicates does not
+    // depend on the order of the command line.
+    std::map<std::string, std::filesystem::path> sources;
+    for (const auto& source_path : source_paths) {
+        sources[sigma::filesystem::make_relative(source_directory, source_path).replace_extension("").string()] = source_path;
+        job.reads(source_path);
+    }
+    job.outputs.push_back(job.material_index);
+
+    auto index_stage = job.stage("index");
+
+    std::map<std::string, std::string> canonical_keys;
+    std::map<std::string, std::vector<std::string>> layouts;
+    material_index index;
+    for (const auto& [key, source_path] : sources) {
+        transient_json j_material;
+        std::ifstream file(source_path);
+        file >> j_material;
+
+        // The signature holds what ends up in the baked material: the
+        // shaders, the bytes of the filled buffers and the textures bound
+        // to the shaders. Values the shaders do not reference, or that are
+        // spelled differently in the .smat, do not split duplicates.
+        transient_json j_shaders = transient_json::object();
+        transient_json j_buffers = transient_json::object();
+        transient_json j_textures = transient_json::object();
+        std::map<size_t, std::shared_ptr<sigma::graphics::buffer>> buffers;
+        auto textures_j = j_material.find("textures");
+        for (const auto& item : j_material.items()) {
+            if (!material_shader_keys.count(item.key()))
+                continue;
+
+            auto shader_key = item.key() / sigma::resource::key_type(item.value().get<std::string>());
+            j_shaders[item.key()] = shader_key.string();
+
+            const auto& shader_schema = job.get(shader_cache, "shader", shader_key)->schema();
+            for (const auto& buff_schema : shader_schema.buffers) {
+                auto& buffer = buffers[buff_schema.binding_point];
+                if (!buffer)
+                    buffer = std::make_shared<sigma::graphics::buffer>(context, key / sigma::resource::key_type(buff_schema.name), buff_schema);
+                else if (!buffer->merge(buff_schema))
+                    throw std::runtime_error("Buffer schema miss-match in material: " + key);
+            }
+
+            if (textures_j == j_material.end())
+                continue;
+
+            for (const auto& tex_schema : shader_schema.textures) {
+                auto texture_j = textures_j->find(tex_schema.name);
+                if (texture_j != textures_j->end())
+                    j_textures[tex_schema.name] = *texture_j;
+            }
+        }
+
+        for (const auto& [binding_point, buffer] : buffers) {
+            sigma::graphics::from_json(j_material, *buffer);
+            const auto& data = buffer->data();
+            j_buffers[std::to_string(binding_point)] = content_hash(data.data(), data.size());
+        }
+
+        // Materials can only share instanced state if they bind the same
+        // shaders and textures, the buffers become the per instance data.
+        auto layout = transient_json { { "shaders", j_shaders }, { "textures", j_textures } }.dump();
+        auto signature = transient_json { { "shaders", j_shaders }, { "buffers", j_buffers }, { "textures", j_textures } }.dump();
+
+        auto [it, inserted] = canonical_keys.emplace(signature, key);
+        if (inserted)
+            layouts[layout].push_back(key);
+        else
+            index.aliases[key] = it->second;
+    }
 
-    for (auto buffer : material->buffers()) {
-        buffer_cache->write_to_disk(buffer.second->key());
+    for (auto& [layout, keys] : layouts) {
+        if (keys.size() > 1)
+            index.instance_groups.push_back(std::move(keys));
     }
 
-    material_cache->insert(key, material, true);
+    index.save(job.material_index);
 }
@@ -1,3 +1,6 @@
+#include "bake.hpp"
+#include "material_index.hpp"
+
 #include <sigma/context.hpp>
 #include <sigma/graphics/static_mesh.hpp>
 #include <sigma/resource/cache.hpp>
@@ -10,8 +13,14 @@
 
 #include <glm/gtc/quaternion.hpp>
 
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
 
 using namespace std::literals::string_literals;
 
@@ -69,6 +78,8 @@ std::string get_name(const aiNode* node)
 
 void convert_static_mesh(
     std::shared_ptr<sigma::context> context,
+    bake_job& job,
+    const material_index& materials,
     const std::filesystem::path& source_directory,
     const aiScene* scene,
     const aiMesh* src_mesh,
@@ -77,8 +88,8 @@ void convert_static_mesh(
     auto material_cache = context->cache<sigma::graphics::material>();
 
     float radius = dest_mesh->radius();
-    std::vector<sigma::graphics::static_mesh::vertex> submesh_vertices(src_mesh->mNumVertices);
-    std::vector<sigma::graphics::static_mesh::triangle> submesh_triangles(src_mesh->mNumFaces);
+    std::pmr::vector<sigma::graphics::static_mesh::vertex> submesh_vertices(src_mesh->mNumVertices, job.memory);
+    std::pmr::vector<sigma::graphics::static_mesh::triangle> submesh_triangles(src_mesh->mNumFaces, job.memory);
 
     for (unsigned int j = 0; j < src_mesh->mNumVertices; ++j) {
         auto pos = src_mesh->mVertices[j];
@@ -105,7 +116,7 @@ void convert_static_mesh(
             submesh_triangles[j][k] = f.mIndices[k] + static_cast<unsigned int>(dest_mesh->vertices().size());
     }
 
-    std::string material_name = get_name(scene->mMaterials[src_mesh->mMaterialIndex], source_directory);
+    std::string material_name = materials.resolve(get_name(scene->mMaterials[src_mesh->mMaterialIndex], source_directory));
 
     dest_mesh->vertices().reserve(dest_mesh->vertices().size() + submesh_vertices.size());
     dest_mesh->vertices().insert(dest_mesh->vertices().end(), submesh_vertices.begin(), submesh_vertices.end());
@@ -113,64 +124,158 @@ void convert_static_mesh(
     dest_mesh->triangles().reserve(dest_mesh->triangles().size() + submesh_triangles.size());
     dest_mesh->triangles().insert(dest_mesh->triangles().end(), submesh_triangles.begin(), submesh_triangles.end());
 
-    dest_mesh->parts().push_back(sigma::graphics::mesh_part { dest_mesh->triangles().size(), submesh_triangles.size(), material_cache->get(material_name) });
+    auto material = job.reference(material_cache, "material", material_name, [&]() {
+        return std::make_shared<sigma::graphics::material>(context, material_name);
+    });
+
+    dest_mesh->parts().push_back(sigma::graphics::mesh_part { dest_mesh->triangles().size(), submesh_triangles.size(), material });
 
     dest_mesh->set_radius(radius);
 }
 
-void bake_mesh(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
+// Header of a baked position stream, followed by vertex_count tightly packed
+// vec3 positions and index_count 32 bit indices, all in native byte order.
+struct position_stream_header {
+    char magic[4] = { 'S', 'P', 'O', 'S' };
+    std::uint32_t version = 1;
+    std::uint32_t vertex_count = 0;
+    std::uint32_t index_count = 0;
+};
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "position streams are tightly packed");
+
+struct position_bits_hash {
+    size_t operator()(const std::array<std::uint32_t, 3>& bits) const
+    {
+        std::uint64_t h = bits[0];
+        h = h * 0x9e3779b97f4a7c15ull + bits[1];
+        h = h * 0x9e3779b97f4a7c15ull + bits[2];
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+// Position only copy of the mesh for depth and shadow passes. Vertices are
+// welded by position alone, so seams in normals or texture coordinates no
+// longer split them. Triangles keep their order, the parts of the static
+// mesh index both.
+std::vector<char> make_position_stream(bake_job& job, std::shared_ptr<sigma::graphics::static_mesh> mesh)
+{
+    const auto& vertices = mesh->vertices();
+    const auto& triangles = mesh->triangles();
+
+    std::pmr::unordered_map<std::array<std::uint32_t, 3>, std::uint32_t, position_bits_hash> welded(job.memory);
+    welded.reserve(vertices.size());
+    std::pmr::vector<std::uint32_t> remap(vertices.size(), job.memory);
+    std::pmr::vector<glm::vec3> positions(job.memory);
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        std::array<std::uint32_t, 3> bits;
+        for (int k = 0; k < 3; ++k) {
+            // Adding zero turns -0 into 0, they have to weld.
+            float value = vertices[i].position[k] + 0.0f;
+            std::memcpy(&bits[k], &value, sizeof(value));
+        }
+
+        auto [it, inserted] = welded.emplace(bits, static_cast<std::uint32_t>(positions.size()));
+        if (inserted)
+            positions.push_back(vertices[i].position);
+        remap[i] = it->second;
+    }
+
+    position_stream_header header;
+    header.vertex_count = static_cast<std::uint32_t>(positions.size());
+    header.index_count = static_cast<std::uint32_t>(triangles.size() * 3);
+
+    std::vector<char> data(sizeof(header) + positions.size() * sizeof(glm::vec3) + header.index_count * sizeof(std::uint32_t));
+    char* out = data.data();
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memcpy(out, positions.data(), positions.size() * sizeof(glm::vec3));
+    out += positions.size() * sizeof(glm::vec3);
+    for (const auto& triangle : triangles) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            std::uint32_t index = remap[triangle[k]];
+            std::memcpy(out, &index, sizeof(index));
+            out += sizeof(index);
+        }
+    }
+    return data;
+}
+
+void bake_mesh(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
 {
     std::string source_str = source_path.string();
     auto key = sigma::filesystem::make_relative(source_directory, source_path).replace_extension("");
-    auto mesh_cache = context->cache<sigma::graphics::static_mesh>();
+
+    job.produces("static_mesh", key);
+    if (job.position_streams)
+        job.outputs.push_back(job.resource_path("position_stream", key));
+    job.reads(source_path);
 
     // TODO FEATURE add settings.
 
     Assimp::Importer importer;
 
-    const aiScene* scene = importer.ReadFile(source_str.c_str(),
-        aiProcess_CalcTangentSpace
-            | aiProcess_JoinIdenticalVertices
-            | aiProcess_Triangulate
-            // | aiProcess_LimitBoneWeights
-            | aiProcess_ValidateDataStructure
-            | aiProcess_ImproveCacheLocality
-            // | aiProcess_RemoveRedundantMaterials
-            | aiProcess_SortByPType
-            | aiProcess_FindDegenerates
-            | aiProcess_FindInvalidData
-            // | aiProcess_GenUVCoords
-            // | aiProcess_FindInstances
-            | aiProcess_FlipUVs
-            | aiProcess_CalcTangentSpace
-            // | aiProcess_MakeLeftHanded
-            | aiProcess_RemoveComponent
-            // | aiProcess_GenNormals
-            // | aiProcess_GenSmoothNormals
-            // | aiProcess_SplitLargeMeshes
-            | aiProcess_PreTransformVertices
-            // | aiProcess_FixInfacingNormals
-            // | aiProcess_TransformUVCoords
-            // | aiProcess_ConvertToLeftHanded
-            | aiProcess_OptimizeMeshes
-        // | aiProcess_OptimizeGraph
-        // | aiProcess_FlipWindingOrder
-        // | aiProcess_SplitByBoneCount
-        // | aiProcess_Debone
-    );
+    const aiScene* scene = nullptr;
+    {
+        auto importing = job.stage("import");
+        scene = importer.ReadFile(source_str.c_str(),
+            aiProcess_CalcTangentSpace
+                | aiProcess_JoinIdenticalVertices
+                | aiProcess_Triangulate
+                // | aiProcess_LimitBoneWeights
+                | aiProcess_ValidateDataStructure
+                | aiProcess_ImproveCacheLocality
+                // | aiProcess_RemoveRedundantMaterials
+                | aiProcess_SortByPType
+                | aiProcess_FindDegenerates
+                | aiProcess_FindInvalidData
+                // | aiProcess_GenUVCoords
+                // | aiProcess_FindInstances
+                | aiProcess_FlipUVs
+                | aiProcess_CalcTangentSpace
+                // | aiProcess_MakeLeftHanded
+                | aiProcess_RemoveComponent
+                // | aiProcess_GenNormals
+                // | aiProcess_GenSmoothNormals
+                // | aiProcess_SplitLargeMeshes
+                | aiProcess_PreTransformVertices
+                // | aiProcess_FixInfacingNormals
+                // | aiProcess_TransformUVCoords
+                // | aiProcess_ConvertToLeftHanded
+                | aiProcess_OptimizeMeshes
+            // | aiProcess_OptimizeGraph
+            // | aiProcess_FlipWindingOrder
+            // | aiProcess_SplitByBoneCount
+            // | aiProcess_Debone
+        );
+    }
 
     if (scene == nullptr)
         throw std::runtime_error(importer.GetErrorString());
 
+    material_index materials;
+    if (!job.material_index.empty()) {
+        job.reads(job.material_index);
+        materials = material_index::load(job.material_index);
+    }
+
     auto dest_mesh = std::make_shared<sigma::graphics::static_mesh>(context, key);
-    for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
-        if (sigma::util::ends_with(get_name(scene->mMeshes[i]), "_high"s))
-            continue;
-        convert_static_mesh(context, key.parent_path(), scene, scene->mMeshes[i], dest_mesh);
+    {
+        auto convert = job.stage("convert");
+        for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+            if (sigma::util::ends_with(get_name(scene->mMeshes[i]), "_high"s))
+                continue;
+            convert_static_mesh(context, job, materials, key.parent_path(), scene, scene->mMeshes[i], dest_mesh);
+        }
+        dest_mesh->vertices().shrink_to_fit();
+        dest_mesh->triangles().shrink_to_fit();
+        dest_mesh->parts().shrink_to_fit();
+    }
+
+    if (job.position_streams) {
+        auto positions = job.stage("positions");
+        job.write_file("position_stream", key, make_position_stream(job, dest_mesh));
     }
-    dest_mesh->vertices().shrink_to_fit();
-    dest_mesh->triangles().shrink_to_fit();
-    dest_mesh->parts().shrink_to_fit();
 
-    mesh_cache->insert(key, dest_mesh, true);
+    job.write("static_mesh", key, dest_mesh);
 }
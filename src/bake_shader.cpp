@@ -1,16 +1,17 @@
+#include "bake.hpp"
+#include "transient_json.hpp"
+
 #include <sigma/context.hpp>
 #include <sigma/graphics/shader.hpp>
 #include <sigma/resource/cache.hpp>
 #include <sigma/util/filesystem.hpp>
 
-#include <nlohmann/json.hpp>
-
 #include <filesystem>
 #include <iostream>
 
 namespace sigma {
 namespace graphics {
-    void from_json(const nlohmann::json& j, buffer_member& member)
+    void from_json(const transient_json& j, buffer_member& member)
     {
         std::string type = j["type"].get<std::string>();
         auto array_it = j.find("array");
@@ -54,7 +55,7 @@ namespace graphics {
         }
     }
 
-    void from_json(const nlohmann::json& j, buffer_schema& schema)
+    void from_json(const transient_json& j, buffer_schema& schema)
     {
         for (const auto& member_j : j["members"]) {
             buffer_member member = member_j;
@@ -62,7 +63,7 @@ namespace graphics {
         }
     }
 
-    void from_json(const nlohmann::json& j, shader_schema& schema)
+    void from_json(const transient_json& j, shader_schema& schema)
     {
         auto ubos_it = j.find("ubos");
         if (ubos_it != j.end()) {
@@ -99,7 +100,7 @@ namespace graphics {
 }
 }
 
-void bake_shader(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
+void bake_shader(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
 {
     static const std::unordered_map<std::string, sigma::graphics::shader_type> source_types = {
         { ".vert_spv", { sigma::graphics::shader_type::vertex } },
@@ -121,23 +122,32 @@ void bake_shader(std::shared_ptr<sigma::context> context, const std::filesystem:
     auto source_type = source_types.at(source_path.extension().string());
     auto key = sigma::filesystem::make_relative(source_directory, source_path).replace_extension("");
 
+    job.produces("shader", key);
+    job.reads(source_path);
+
     // Load the SPIRV source code
-    std::ifstream source { source_path.string() };
     std::vector<unsigned char> spirv;
-    spirv.insert(spirv.end(),
-        std::istreambuf_iterator<char> { source.rdbuf() },
-        std::istreambuf_iterator<char> {});
+    {
+        auto read = job.stage("read");
+        std::ifstream source { source_path.string() };
+        spirv.insert(spirv.end(),
+            std::istreambuf_iterator<char> { source.rdbuf() },
+            std::istreambuf_iterator<char> {});
+    }
 
     // Read the SPIRV reflection data
     sigma::graphics::shader_schema schema;
     auto reflect_path = source_path.string() + ".json";
-    nlohmann::json j_reflection;
-    std::ifstream file(reflect_path);
-    file >> j_reflection;
-    schema = j_reflection;
+    job.reads(reflect_path);
+    {
+        auto reflect = job.stage("reflect");
+        transient_json j_reflection;
+        std::ifstream file(reflect_path);
+        file >> j_reflection;
+        schema = j_reflection;
+    }
 
-    auto cache = context->cache<sigma::graphics::shader>();
     auto shader = std::make_shared<sigma::graphics::shader>(context, key);
     shader->add_source(source_type, std::move(spirv), std::move(schema));
-    cache->insert(key, shader, true);
+    job.write("shader", key, shader);
 }
@@ -1,15 +1,28 @@
+#include "bake.hpp"
+#include "content_hash.hpp"
+#include "texture_analysis.hpp"
+#include "transient_json.hpp"
+#include "transient_memory.hpp"
+
 #include <sigma/context.hpp>
 #include <sigma/graphics/texture.hpp>
 #include <sigma/resource/cache.hpp>
 #include <sigma/util/filesystem.hpp>
 #include <sigma/util/string.hpp>
 
+#define STBI_MALLOC(size) transient_allocate(size)
+#define STBI_REALLOC(ptr, size) transient_reallocate(ptr, size)
+#define STBI_FREE(ptr) transient_deallocate(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
-#include <nlohmann/json.hpp>
 
 #include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
 
 namespace sigma {
 namespace graphics {
@@ -18,9 +31,18 @@ namespace graphics {
         texture_filter minification = texture_filter::LINEAR;
         texture_filter magnification = texture_filter::LINEAR;
         texture_filter mipmap = texture_filter::LINEAR;
+
+        // Pick RGB32F for HDR images, RGBA8 for images with transparency and
+        // RGB8 otherwise, instead of "format". Can bake to a larger format
+        // than the RGB8 default, so only with "automatic_format" in the .stex.
+        bool automatic_format = false;
+
+        // Store single colour images as one pixel. Changes the size the
+        // shaders see, so only with "collapse_constant" in the .stex.
+        bool collapse_constant = false;
     };
 
-    void from_json(const nlohmann::json& j, texture_filter& flt)
+    void from_json(const transient_json& j, texture_filter& flt)
     {
         static std::map<std::string, texture_filter> filter_map = {
             { "NEAREST", texture_filter::NEAREST },
@@ -37,7 +59,7 @@ namespace graphics {
             flt = texture_filter::LINEAR;
     }
 
-    void from_json(const nlohmann::json& j, texture_format& fmt)
+    void from_json(const transient_json& j, texture_format& fmt)
     {
         static std::map<std::string, texture_format> format_map = {
             { "RGB8", texture_format::RGB8 },
@@ -57,12 +79,20 @@ namespace graphics {
             fmt = texture_format::RGB8;
     }
 
-    void from_json(const nlohmann::json& j, texture_settings& settings)
+    void from_json(const transient_json& j, texture_settings& settings)
     {
         auto format_j = j.find("format");
         if (format_j != j.end())
             settings.format = *format_j;
 
+        auto automatic_j = j.find("automatic_format");
+        if (automatic_j != j.end())
+            settings.automatic_format = *automatic_j;
+
+        auto collapse_j = j.find("collapse_constant");
+        if (collapse_j != j.end())
+            settings.collapse_constant = *collapse_j;
+
         auto filter_j = j.find("filter");
         if (filter_j != j.end()) {
             auto min_j = filter_j->find("minification");
@@ -81,65 +111,175 @@ namespace graphics {
 }
 }
 
+// stb_image reads through int offsets, larger files are refused instead of
+// being decoded from a truncated stream.
+void check_texture_size(const std::filesystem::path& source_path)
+{
+    std::error_code error;
+    auto size = std::filesystem::file_size(source_path, error);
+    if (error)
+        throw std::runtime_error("Could not read texture '" + source_path.string() + "': " + error.message());
+    if (size > static_cast<std::uintmax_t>(std::numeric_limits<int>::max()))
+        throw std::runtime_error("Could not load texture '" + source_path.string() + "': larger than " + std::to_string(std::numeric_limits<int>::max()) + " bytes");
+}
+
+template <class Image>
+void store_pixels(const std::filesystem::path& source_path, typename Image::pixel_type* pixels, int width, int height, Image& image)
+{
+    if (pixels == nullptr)
+        throw std::runtime_error("Could not load texture '" + source_path.string() + "': " + stbi_failure_reason());
+
+    image.size = { width, height };
+    image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height);
+    stbi_image_free((void*)pixels);
+}
+
 template <class Image>
 void load_texture(const std::filesystem::path& source_path, Image& image)
 {
     auto file_path_string = source_path.string();
+
     int width, height, bbp;
     auto pixels = (typename Image::pixel_type*)stbi_load(file_path_string.c_str(), &width, &height, &bbp, sigma::graphics::channel_count_v<Image>);
-    image.size = { width, height };
-    image.pixels.resize(width * height);
-    std::copy(pixels, pixels + (width * height), image.pixels.begin());
-    stbi_image_free((void*)pixels);
+    store_pixels(source_path, pixels, width, height, image);
 }
 
 void load_texture(const std::filesystem::path& source_path, sigma::graphics::image_t<sigma::graphics::rgb32f_pixel_t>& image)
 {
     auto file_path_string = source_path.string();
+
     int width, height, bbp;
     auto pixels = (sigma::graphics::rgb32f_pixel_t*)stbi_loadf(file_path_string.c_str(), &width, &height, &bbp, 3);
-    image.size = { width, height };
-    image.pixels.resize(width * height);
-    std::copy(pixels, pixels + (width * height), image.pixels.begin());
-    stbi_image_free((void*)pixels);
+    store_pixels(source_path, pixels, width, height, image);
+}
+
+// Identifies the baked texture, everything passed to the texture besides
+// its key goes into the hash.
+template <class Image>
+std::string texture_hash(const Image& image, sigma::graphics::texture_format format, const sigma::graphics::texture_settings& settings)
+{
+    std::ostringstream header;
+    header << image.size.x << 'x' << image.size.y << ':' << static_cast<int>(format) << ':'
+           << static_cast<int>(settings.minification) << ':' << static_cast<int>(settings.magnification) << ':' << static_cast<int>(settings.mipmap) << ':'
+           << content_hash(image.pixels.data(), image.pixels.size() * sizeof(typename Image::pixel_type));
+    return content_hash(header.str().data(), header.str().size());
+}
+
+template <class Image>
+void write_texture(std::shared_ptr<sigma::context> context, bake_job& job, const sigma::resource::key_type& key, sigma::graphics::texture_format format, const sigma::graphics::texture_settings& settings, const Image& image)
+{
+    std::string hash;
+    {
+        auto hashing = job.stage("hash");
+        hash = texture_hash(image, format, settings);
+    }
+
+    // Identical images are only stored once, the texture links to the copy
+    // baked first.
+    if (job.link_content("texture", key, hash))
+        return;
+
+    auto convert = job.stage("convert");
+    auto texture = std::make_shared<sigma::graphics::texture>(context, key, image, settings.minification, settings.magnification, settings.mipmap);
+    job.write_content("texture", key, hash, texture);
+}
+
+template <class Image>
+void bake_image(std::shared_ptr<sigma::context> context, bake_job& job, const sigma::resource::key_type& key, const std::filesystem::path& source_path, sigma::graphics::texture_format format, const sigma::graphics::texture_settings& settings)
+{
+    Image image;
+    {
+        auto decode = job.stage("decode");
+        load_texture(source_path, image);
+    }
+    write_texture(context, job, key, format, settings, image);
+}
+
+// Decodes to RGBA8 and scans the pixels. RGBA8 drops to RGB8 for opaque
+// images, single colour images shrink to one pixel if the settings allow it.
+void bake_analyzed_texture(std::shared_ptr<sigma::context> context, bake_job& job, const sigma::resource::key_type& key, const std::filesystem::path& source_path, sigma::graphics::texture_format format, const sigma::graphics::texture_settings& settings)
+{
+    using namespace sigma::graphics;
+
+    auto file_path_string = source_path.string();
+
+    int width, height, bbp;
+    stbi_uc* pixels;
+    {
+        auto decode = job.stage("decode");
+        pixels = stbi_load(file_path_string.c_str(), &width, &height, &bbp, 4);
+    }
+    if (pixels == nullptr)
+        throw std::runtime_error("Could not load texture '" + source_path.string() + "': " + stbi_failure_reason());
+
+    texture_analysis analysis;
+    {
+        auto analyze = job.stage("analyze");
+        analysis = analyze_rgba8(pixels, static_cast<size_t>(width) * height);
+    }
+
+    if (analysis.constant && settings.collapse_constant)
+        width = height = 1;
+
+    if (analysis.opaque || format == texture_format::RGB8) {
+        image_t<rgb8_pixel_t> image;
+        {
+            auto convert = job.stage("convert");
+            image.size = { width, height };
+            image.pixels.resize(static_cast<size_t>(width) * height);
+            rgba8_to_rgb8(pixels, reinterpret_cast<unsigned char*>(image.pixels.data()), image.pixels.size());
+            stbi_image_free(pixels);
+        }
+        write_texture(context, job, key, texture_format::RGB8, settings, image);
+    } else {
+        image_t<rgba8_pixel_t> image;
+        store_pixels(source_path, reinterpret_cast<rgba8_pixel_t*>(pixels), width, height, image);
+        write_texture(context, job, key, texture_format::RGBA8, settings, image);
+    }
 }
 
-void bake_texture(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
+void bake_texture(std::shared_ptr<sigma::context> context, bake_job& job, const std::filesystem::path& source_directory, const std::filesystem::path& source_path)
 {
     auto key = sigma::filesystem::make_relative(source_directory, source_path).replace_extension("");
     auto settings_path = source_path.parent_path() / (source_path.stem().string() + ".stex");
 
-    auto cache = context->cache<sigma::graphics::texture>();
+    job.produces("texture", key);
+    job.reads(source_path);
 
     sigma::graphics::texture_settings settings;
     if (std::filesystem::exists(settings_path)) {
-        nlohmann::json j_settings;
+        auto parse = job.stage("settings");
+        job.reads(settings_path);
+
+        transient_json j_settings;
         std::ifstream file(settings_path.string());
         file >> j_settings;
         settings = j_settings;
     }
 
-    std::shared_ptr<sigma::graphics::texture> texture;
-    switch (settings.format) {
-    case sigma::graphics::texture_format::RGB8: {
-        sigma::graphics::image_t<sigma::graphics::rgb8_pixel_t> image;
-        load_texture(source_path, image);
-        texture = std::make_shared<sigma::graphics::texture>(context, key, image, settings.minification, settings.magnification, settings.mipmap);
-        break;
+    check_texture_size(source_path);
+
+    auto format = settings.format;
+    if (settings.automatic_format) {
+        auto file_path_string = source_path.string();
+        format = stbi_is_hdr(file_path_string.c_str()) ? sigma::graphics::texture_format::RGB32F : sigma::graphics::texture_format::RGBA8;
     }
-    case sigma::graphics::texture_format::RGBA8: {
-        sigma::graphics::image_t<sigma::graphics::rgba8_pixel_t> image;
-        load_texture(source_path, image);
-        texture = std::make_shared<sigma::graphics::texture>(context, key, image, settings.minification, settings.magnification, settings.mipmap);
+
+    // The scan only runs where it can make the texture smaller: RGBA8 may
+    // lose its alpha channel and RGB8 may collapse a single colour image.
+    if (format == sigma::graphics::texture_format::RGBA8 || (format == sigma::graphics::texture_format::RGB8 && settings.collapse_constant)) {
+        bake_analyzed_texture(context, job, key, source_path, format, settings);
+        return;
+    }
+
+    switch (format) {
+    case sigma::graphics::texture_format::RGB8: {
+        bake_image<sigma::graphics::image_t<sigma::graphics::rgb8_pixel_t>>(context, job, key, source_path, format, settings);
         break;
     }
     case sigma::graphics::texture_format::RGB32F: {
-        sigma::graphics::image_t<sigma::graphics::rgb32f_pixel_t> image;
-        load_texture(source_path, image);
-        texture = std::make_shared<sigma::graphics::texture>(context, key, image, settings.minification, settings.magnification, settings.mipmap);
+        bake_image<sigma::graphics::image_t<sigma::graphics::rgb32f_pixel_t>>(context, job, key, source_path, format, settings);
         break;
     }
     }
-
-    cache->insert(key, texture, true);
 }
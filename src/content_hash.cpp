@@ -0,0 +1,77 @@
+#include "content_hash.hpp"
+
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace {
+std::uint64_t mix(std::uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+struct hash128 {
+    std::uint64_t low = 0x9e3779b97f4a7c15ull;
+    std::uint64_t high = 0xc2b2ae3d27d4eb4full;
+
+    void add(std::uint64_t value)
+    {
+        low = mix(low ^ value) + 0x165667b19e3779f9ull;
+        high = mix(high + value) ^ 0x27d4eb2f165667c5ull;
+    }
+};
+
+hash128 hash_block(const unsigned char* data, std::size_t size)
+{
+    hash128 h;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        std::uint64_t value;
+        std::memcpy(&value, data + i, sizeof(value));
+        h.add(value);
+    }
+
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    h.add(tail);
+    h.add(size);
+    return h;
+}
+}
+
+std::string content_hash(const void* data, std::size_t size)
+{
+    // Blocks have a fixed size so the hash does not depend on the number of
+    // threads that computed it.
+    const std::size_t block_size = 1 << 20;
+    auto bytes = static_cast<const unsigned char*>(data);
+
+    std::size_t block_count = (size + block_size - 1) / block_size;
+    std::vector<hash128> blocks(block_count);
+    parallel_for(block_count, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t block = begin; block < end; ++block) {
+            std::size_t offset = block * block_size;
+            blocks[block] = hash_block(bytes + offset, std::min(block_size, size - offset));
+        }
+    });
+
+    hash128 h;
+    for (const auto& block : blocks) {
+        h.add(block.low);
+        h.add(block.high);
+    }
+    h.add(size);
+
+    std::ostringstream hex;
+    hex << std::hex << std::setfill('0') << std::setw(16) << h.low << std::setw(16) << h.high;
+    return hex.str();
+}
@@ -0,0 +1,10 @@
+#ifndef SIGMA_BAKE_CONTENT_HASH_HPP
+#define SIGMA_BAKE_CONTENT_HASH_HPP
+
+#include <cstddef>
+#include <string>
+
+// 128 bit content hash as 32 hex digits, independent of the thread count.
+std::string content_hash(const void* data, std::size_t size);
+
+#endif // SIGMA_BAKE_CONTENT_HASH_HPP
@@ -1,20 +1,34 @@
+#include "bake.hpp"
+#include "transient_memory.hpp"
+
 #include <sigma/context.hpp>
 #include <sigma/util/filesystem.hpp>
 
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
-void bake_texture(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
-void bake_shader(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
-void bake_material(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
-void bake_mesh(std::shared_ptr<sigma::context> context, const std::filesystem::path& source_directory, const std::filesystem::path& source_path);
+namespace {
+std::uintmax_t total_file_size(const std::vector<std::filesystem::path>& paths, size_t first)
+{
+    std::uintmax_t size = 0;
+    for (size_t i = first; i < paths.size(); ++i) {
+        std::error_code ec;
+        auto file_size = std::filesystem::file_size(paths[i], ec);
+        if (!ec)
+            size += file_size;
+    }
+    return size;
+}
+}
 
 int main(int argc, char* argv[])
 {
-    std::unordered_map<std::string, void (*)(std::shared_ptr<sigma::context>, const std::filesystem::path&, const std::filesystem::path&)> bakers = {
+    std::unordered_map<std::string, void (*)(std::shared_ptr<sigma::context>, bake_job&, const std::filesystem::path&, const std::filesystem::path&)> bakers = {
         // Textures
         { ".tiff", bake_texture },
         { ".tif", bake_texture },
@@ -78,6 +92,13 @@ int main(int argc, char* argv[])
 
     auto cache_dir = std::filesystem::current_path();
     auto source_directory = cache_dir;
+    std::filesystem::path material_index;
+    std::filesystem::path depfile;
+    std::filesystem::path stamp;
+    bool load_dependencies = false;
+    bool position_streams = false;
+    std::filesystem::path profile_path;
+    std::filesystem::path profile_summary_path;
     std::vector<std::filesystem::path> source_files;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -88,20 +109,119 @@ int main(int argc, char* argv[])
                 std::cerr << "missing --output value!";
                 return -1;
             }
+        } else if (arg == "--material-index") {
+            if (i + 1 < argc) {
+                material_index = argv[++i];
+            } else {
+                std::cerr << "missing --material-index value!";
+                return -1;
+            }
+        } else if (arg == "--depfile") {
+            if (i + 1 < argc) {
+                depfile = argv[++i];
+            } else {
+                std::cerr << "missing --depfile value!";
+                return -1;
+            }
+        } else if (arg == "--stamp") {
+            if (i + 1 < argc) {
+                stamp = argv[++i];
+            } else {
+                std::cerr << "missing --stamp value!";
+                return -1;
+            }
+        } else if (arg == "--profile") {
+            if (i + 1 < argc) {
+                profile_path = argv[++i];
+            } else {
+                std::cerr << "missing --profile value!";
+                return -1;
+            }
+        } else if (arg == "--profile-summary") {
+            if (i + 1 < argc) {
+                profile_summary_path = argv[++i];
+            } else {
+                std::cerr << "missing --profile-summary value!";
+                return -1;
+            }
+        } else if (arg == "--load-dependencies") {
+            load_dependencies = true;
+        } else if (arg == "--position-streams") {
+            position_streams = true;
         } else {
             source_files.push_back(argv[i]);
         }
     }
 
+    // Summarizes the traces of earlier --profile runs instead of baking, a
+    // directory is searched for traces recursively.
+    if (!profile_summary_path.empty()) {
+        profiler profile;
+        if (std::filesystem::is_directory(profile_summary_path)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(profile_summary_path)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".json")
+                    profile.read_trace(entry.path());
+            }
+        } else {
+            profile.read_trace(profile_summary_path);
+        }
+        profile.write_summary(std::cout);
+        return 0;
+    }
+
     std::filesystem::create_directories(cache_dir);
     auto context = std::make_shared<sigma::context>(cache_dir);
 
+    bake_job job;
+    job.output_directory = cache_dir;
+    job.material_index = material_index;
+    job.load_dependencies = load_dependencies;
+    job.position_streams = position_streams;
+
+    // The stamp is the primary output of the build step, it has to come
+    // first in the depfile.
+    if (!stamp.empty())
+        job.outputs.push_back(stamp);
+
+    output_writer writer { cache_dir };
+    job.writer = &writer;
+
+    profiler profile;
+    if (!profile_path.empty())
+        job.profile = &profile;
+
+    // Transient bake data is pooled in an arena that is reset after every
+    // asset, the initial block is reused so a batch does not keep growing the
+    // heap.
+    transient_memory_resource transient { 64 * 1024 * 1024 };
+    job.memory = &transient;
+
+    auto bake = [&](const std::string& name, auto&& baker) {
+        job.inputs.clear();
+        auto first_output = job.outputs.size();
+        if (job.profile)
+            job.profile->begin_asset(name);
+        {
+            transient_memory_scope transient_memory { &transient };
+            baker();
+        }
+        job.flush();
+        transient.release();
+        if (job.profile)
+            job.profile->end_asset(total_file_size(job.inputs, 0), total_file_size(job.outputs, first_output));
+    };
+
+    // With an index, materials are not baked but collapsed into the package
+    // material index that the static meshes resolve their materials through.
+    std::vector<std::filesystem::path> material_files;
     for (const auto& src : source_files) {
         auto src_path = std::filesystem::absolute(src);
         if (sigma::filesystem::contains_file(source_directory, src_path) && std::filesystem::exists(src_path)) {
             auto ext = src_path.extension().string();
-            if (bakers.count(ext)) {
-                bakers[ext](context, source_directory, src_path);
+            if (ext == ".smat" && !material_index.empty()) {
+                material_files.push_back(src_path);
+            } else if (bakers.count(ext)) {
+                bake(src.string(), [&]() { bakers[ext](context, job, source_directory, src_path); });
             } else {
                 std::cerr << "sigma-bake: error: File '" << src << "' is not supported'!\n";
                 return -1;
@@ -112,5 +232,31 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (!material_files.empty()) {
+        bake(material_index.string(), [&]() {
+            if (job.profile)
+                job.profile->set_asset_type("material_index");
+            index_materials(context, job, source_directory, material_files);
+        });
+    }
+
+    // Outputs have to be in place before the depfile claims they are.
+    writer.wait();
+    job.prune_content();
+
+    // Touched on every run, unlike outputs that are only rewritten when their
+    // content changed.
+    if (!stamp.empty()) {
+        if (stamp.has_parent_path())
+            std::filesystem::create_directories(stamp.parent_path());
+        std::ofstream { stamp };
+    }
+
+    if (!depfile.empty())
+        job.write_depfile(depfile);
+
+    if (job.profile)
+        profile.write_trace(profile_path);
+
     return 0;
 }
@@ -0,0 +1,67 @@
+#include "material_index.hpp"
+
+#include <fstream>
+
+std::string material_index::resolve(const std::string& key) const
+{
+    auto it = aliases.find(key);
+    if (it != aliases.end())
+        return it->second;
+    return key;
+}
+
+material_index material_index::load(const std::filesystem::path& path)
+{
+    material_index index;
+    if (std::filesystem::exists(path)) {
+        nlohmann::json j_index;
+        std::ifstream file(path);
+        file >> j_index;
+        index = j_index;
+    }
+    return index;
+}
+
+bool material_index::save(const std::filesystem::path& path) const
+{
+    nlohmann::json j_index = *this;
+
+    // Leave the file untouched when nothing changed, the build step writes
+    // it as a byproduct next to a stamp so the build restats it and meshes
+    // that depend on it are not rebaked.
+    if (std::filesystem::exists(path)) {
+        nlohmann::json j_current;
+        std::ifstream file(path);
+        file >> j_current;
+        if (j_current == j_index)
+            return false;
+    }
+
+    // Replace the index in one step so readers never see a partial file.
+    std::filesystem::create_directories(path.parent_path());
+    auto temporary_path = path;
+    temporary_path += ".tmp";
+    {
+        std::ofstream file(temporary_path);
+        file << j_index.dump(4);
+    }
+    std::filesystem::rename(temporary_path, path);
+    return true;
+}
+
+void to_json(nlohmann::json& j, const material_index& index)
+{
+    j["aliases"] = index.aliases;
+    j["instance_groups"] = index.instance_groups;
+}
+
+void from_json(const nlohmann::json& j, material_index& index)
+{
+    auto aliases_j = j.find("aliases");
+    if (aliases_j != j.end())
+        index.aliases = aliases_j->get<std::map<std::string, std::string>>();
+
+    auto groups_j = j.find("instance_groups");
+    if (groups_j != j.end())
+        index.instance_groups = groups_j->get<std::vector<std::vector<std::string>>>();
+}
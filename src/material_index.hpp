@@ -0,0 +1,33 @@
+#ifndef SIGMA_BAKE_MATERIAL_INDEX_HPP
+#define SIGMA_BAKE_MATERIAL_INDEX_HPP
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Package level view of the baked materials.
+//
+// Materials with identical shaders, texture bindings and parameters are
+// collapsed onto a single canonical material, every other key becomes an
+// alias of it. Materials that only differ in their parameter buffers are listed
+// together in an instance group so they can share a parameter array.
+struct material_index {
+    std::map<std::string, std::string> aliases;
+    std::vector<std::vector<std::string>> instance_groups;
+
+    std::string resolve(const std::string& key) const;
+
+    static material_index load(const std::filesystem::path& path);
+
+    // Returns false if the index on disk is already up to date.
+    bool save(const std::filesystem::path& path) const;
+};
+
+void to_json(nlohmann::json& j, const material_index& index);
+
+void from_json(const nlohmann::json& j, material_index& index);
+
+#endif // SIGMA_BAKE_MATERIAL_INDEX_HPP
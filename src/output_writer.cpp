@@ -0,0 +1,191 @@
+#include "output_writer.hpp"
+
+#include <cerrno>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace {
+unsigned long current_process_id()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<unsigned long>(::getpid());
+#endif
+}
+
+bool process_running(unsigned long id)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(id));
+    if (process == nullptr)
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+#else
+    return ::kill(static_cast<pid_t>(id), 0) == 0 || errno == EPERM;
+#endif
+}
+
+// Staging directories are named <process id>-<random> so the ones left
+// behind by a crashed run can be told apart from those of running bakes.
+std::string unique_name()
+{
+    std::random_device random;
+    std::ostringstream name;
+    name << current_process_id() << '-' << std::hex << random() << random();
+    return name.str();
+}
+
+void remove_stale_staging_directories(const std::filesystem::path& staging_root)
+{
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(staging_root, ec)) {
+        auto name = entry.path().filename().string();
+        auto separator = name.find('-');
+        if (separator == std::string::npos || separator == 0)
+            continue;
+
+        unsigned long id;
+        try {
+            id = std::stoul(name.substr(0, separator));
+        } catch (const std::exception&) {
+            continue;
+        }
+
+        if (id != current_process_id() && !process_running(id)) {
+            std::error_code remove_ec;
+            std::filesystem::remove_all(entry.path(), remove_ec);
+        }
+    }
+}
+
+// Flushes the content of a file, or the entries of a directory, to disk.
+void sync_path(const std::filesystem::path& path)
+{
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+}
+
+output_writer::output_writer(const std::filesystem::path& output_directory)
+    : output_directory_(output_directory)
+    , staging_directory_(output_directory / "sigma-bake" / "staging" / unique_name())
+{
+    remove_stale_staging_directories(staging_directory_.parent_path());
+
+    // The staging directory has to be on the same file system as the output,
+    // otherwise the renames are not atomic.
+    std::filesystem::create_directories(staging_directory_);
+    staging_context_ = std::make_shared<sigma::context>(staging_directory_);
+    thread_ = std::thread { [this]() { run(); } };
+}
+
+output_writer::~output_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock { mutex_ };
+        stop_ = true;
+    }
+    queued_.notify_one();
+    thread_.join();
+
+    std::error_code ec;
+    std::filesystem::remove_all(staging_directory_, ec);
+}
+
+void output_writer::push(std::vector<write_function> writes)
+{
+    {
+        std::lock_guard<std::mutex> lock { mutex_ };
+        for (auto& write : writes)
+            queue_.push_back(std::move(write));
+    }
+    queued_.notify_one();
+}
+
+void output_writer::wait()
+{
+    std::unique_lock<std::mutex> lock { mutex_ };
+    idle_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+    if (error_)
+        std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+void output_writer::run()
+{
+    std::unique_lock<std::mutex> lock { mutex_ };
+    while (true) {
+        queued_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty())
+            return;
+
+        std::deque<write_function> batch;
+        batch.swap(queue_);
+        busy_ = true;
+        lock.unlock();
+
+        try {
+            for (const auto& write : batch)
+                write(staging_context_, staging_directory_);
+            publish();
+        } catch (...) {
+            // Never publish anything left over from a failed batch.
+            std::error_code ec;
+            std::filesystem::remove_all(staging_directory_, ec);
+            std::filesystem::create_directories(staging_directory_, ec);
+
+            std::lock_guard<std::mutex> error_lock { mutex_ };
+            if (!error_)
+                error_ = std::current_exception();
+        }
+
+        lock.lock();
+        busy_ = false;
+        idle_.notify_all();
+    }
+}
+
+void output_writer::publish()
+{
+    std::vector<std::filesystem::path> staged_files;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(staging_directory_)) {
+        if (entry.is_regular_file())
+            staged_files.push_back(entry.path());
+    }
+
+    // Content first, so a rename never publishes a file whose data is not
+    // on disk yet, then the directories so the renames are durable too.
+    for (const auto& staged_file : staged_files)
+        sync_path(staged_file);
+
+    std::set<std::filesystem::path> output_directories;
+    for (const auto& staged_file : staged_files) {
+        auto output_file = output_directory_ / std::filesystem::relative(staged_file, staging_directory_);
+        std::filesystem::create_directories(output_file.parent_path());
+        std::filesystem::rename(staged_file, output_file);
+        output_directories.insert(output_file.parent_path());
+    }
+
+    for (const auto& directory : output_directories)
+        sync_path(directory);
+}
@@ -0,0 +1,63 @@
+#ifndef SIGMA_BAKE_OUTPUT_WRITER_HPP
+#define SIGMA_BAKE_OUTPUT_WRITER_HPP
+
+#include <sigma/context.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Writes a resource through the cache of the given context, the second
+// argument is the directory the context is rooted in.
+using write_function = std::function<void(const std::shared_ptr<sigma::context>&, const std::filesystem::path&)>;
+
+// Writes baked resources on a background thread while the next asset bakes.
+//
+// Resources are written through a context rooted in a private staging
+// directory next to the output. Everything queued is written as one batch,
+// its files are synced to disk and then renamed into the output tree, so an
+// interrupted bake never leaves a truncated resource behind. Staging
+// directories of crashed runs are removed by the next writer.
+class output_writer {
+public:
+    explicit output_writer(const std::filesystem::path& output_directory);
+
+    output_writer(const output_writer&) = delete;
+
+    output_writer& operator=(const output_writer&) = delete;
+
+    ~output_writer();
+
+    void push(std::vector<write_function> writes);
+
+    // Blocks until everything pushed so far is in place, rethrows the first
+    // error of the writer thread.
+    void wait();
+
+private:
+    void run();
+
+    void publish();
+
+    std::filesystem::path output_directory_;
+    std::filesystem::path staging_directory_;
+    std::shared_ptr<sigma::context> staging_context_;
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable idle_;
+    std::deque<write_function> queue_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    std::thread thread_;
+};
+
+#endif // SIGMA_BAKE_OUTPUT_WRITER_HPP
@@ -0,0 +1,135 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+class thread_pool {
+public:
+    thread_pool()
+    {
+        std::size_t worker_count = std::max<std::size_t>(1, std::thread::hardware_concurrency()) - 1;
+        for (std::size_t i = 0; i < worker_count; ++i)
+            workers_.emplace_back([this]() { work(); });
+    }
+
+    thread_pool(const thread_pool&) = delete;
+
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock { mutex_ };
+            stop_ = true;
+        }
+        queued_.notify_all();
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    std::size_t thread_count() const
+    {
+        return workers_.size() + 1;
+    }
+
+    void run(std::size_t count, const std::function<void(std::size_t)>& task)
+    {
+        auto current = std::make_shared<job>(task, count);
+        {
+            std::lock_guard<std::mutex> lock { mutex_ };
+            jobs_.push_back(current);
+        }
+        queued_.notify_all();
+
+        std::size_t done = help(*current);
+
+        std::unique_lock<std::mutex> lock { mutex_ };
+        current->finished += done;
+        finished_.wait(lock, [&]() { return current->finished == current->count; });
+
+        auto it = std::find(jobs_.begin(), jobs_.end(), current);
+        if (it != jobs_.end())
+            jobs_.erase(it);
+    }
+
+private:
+    struct job {
+        job(const std::function<void(std::size_t)>& task, std::size_t count)
+            : task(task)
+            , count(count)
+        {
+        }
+
+        const std::function<void(std::size_t)>& task;
+        const std::size_t count;
+        std::atomic<std::size_t> next { 0 };
+
+        // Guarded by the pool mutex.
+        std::size_t finished = 0;
+    };
+
+    // Runs tasks of the job until none are left, returns how many it ran.
+    static std::size_t help(job& j)
+    {
+        std::size_t done = 0;
+        for (std::size_t i = j.next++; i < j.count; i = j.next++, ++done)
+            j.task(i);
+        return done;
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock { mutex_ };
+        while (true) {
+            queued_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+            if (stop_)
+                return;
+
+            auto current = jobs_.front();
+            if (current->next >= current->count) {
+                // Every task is taken, the owner removes the job once they finished.
+                jobs_.pop_front();
+                continue;
+            }
+
+            lock.unlock();
+            std::size_t done = help(*current);
+            lock.lock();
+
+            current->finished += done;
+            if (current->finished == current->count)
+                finished_.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable finished_;
+    std::deque<std::shared_ptr<job>> jobs_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
+
+thread_pool& pool()
+{
+    static thread_pool instance;
+    return instance;
+}
+}
+
+std::size_t parallel_thread_count()
+{
+    return pool().thread_count();
+}
+
+void parallel_run(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    pool().run(count, task);
+}
@@ -0,0 +1,39 @@
+#ifndef SIGMA_BAKE_PARALLEL_HPP
+#define SIGMA_BAKE_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+// Number of threads parallel_for spreads work over, including the caller.
+std::size_t parallel_thread_count();
+
+// Runs task(i) for every i in [0, count) on a pool of worker threads that
+// lives as long as the process, the calling thread helps out until all
+// tasks finished. task must not throw.
+void parallel_run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+// Calls f(begin, end) on consecutive ranges of [0, count) spread over the
+// worker threads, work smaller than grain_size is not split up. f must not
+// throw.
+template <class Function>
+void parallel_for(std::size_t count, std::size_t grain_size, Function f)
+{
+    if (count == 0)
+        return;
+
+    std::size_t chunk_count = std::min(parallel_thread_count(), (count + grain_size - 1) / grain_size);
+    if (chunk_count <= 1) {
+        f(std::size_t { 0 }, count);
+        return;
+    }
+
+    std::size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+    chunk_count = (count + chunk_size - 1) / chunk_size;
+    parallel_run(chunk_count, [&](std::size_t chunk) {
+        std::size_t begin = chunk * chunk_size;
+        f(begin, std::min(count, begin + chunk_size));
+    });
+}
+
+#endif // SIGMA_BAKE_PARALLEL_HPP
@@ -0,0 +1,251 @@
+#include "profiler.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+std::uintmax_t peak_resident_set_size()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<std::uintmax_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::uintmax_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+double to_microseconds(profiler::clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+profiler::clock::duration from_microseconds(double microseconds)
+{
+    return std::chrono::duration_cast<profiler::clock::duration>(std::chrono::duration<double, std::micro>(microseconds));
+}
+
+double to_milliseconds(profiler::clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+double to_megabytes(std::uintmax_t bytes)
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+}
+
+profiler::scope::scope(profiler* owner, std::string name)
+    : owner_(owner)
+    , name_(std::move(name))
+{
+    if (owner_)
+        start_ = clock::now();
+}
+
+profiler::scope::~scope()
+{
+    if (owner_ && owner_->in_asset_)
+        owner_->assets_.back().stages.push_back(span { std::move(name_), start_, clock::now() });
+}
+
+profiler::profiler()
+    : start_(clock::now())
+{
+}
+
+void profiler::begin_asset(const std::string& name)
+{
+    asset a;
+    a.name = name;
+    a.start = clock::now();
+    assets_.push_back(std::move(a));
+    in_asset_ = true;
+}
+
+void profiler::set_asset_type(const std::string& type)
+{
+    if (in_asset_)
+        assets_.back().type = type;
+}
+
+void profiler::end_asset(std::uintmax_t bytes_in, std::uintmax_t bytes_out)
+{
+    if (!in_asset_)
+        return;
+
+    auto& a = assets_.back();
+    a.end = clock::now();
+    a.bytes_in = bytes_in;
+    a.bytes_out = bytes_out;
+    a.process_peak_rss = peak_resident_set_size();
+    in_asset_ = false;
+}
+
+std::map<std::string, profiler::clock::duration> profiler::stage_totals() const
+{
+    std::map<std::string, clock::duration> totals;
+    for (const auto& a : assets_) {
+        for (const auto& s : a.stages)
+            totals[s.name] += s.end - s.start;
+    }
+    return totals;
+}
+
+void profiler::write_trace(const std::filesystem::path& path) const
+{
+    nlohmann::json j_events = nlohmann::json::array();
+    for (const auto& a : assets_) {
+        j_events.push_back({ { "name", a.name },
+            { "cat", a.type },
+            { "ph", "X" },
+            { "ts", to_microseconds(a.start - start_) },
+            { "dur", to_microseconds(a.end - a.start) },
+            { "pid", 0 },
+            { "tid", 0 },
+            { "args", { { "bytes_in", a.bytes_in }, { "bytes_out", a.bytes_out }, { "process_peak_rss", a.process_peak_rss } } } });
+
+        for (const auto& s : a.stages) {
+            j_events.push_back({ { "name", s.name },
+                { "cat", a.type },
+                { "ph", "X" },
+                { "ts", to_microseconds(s.start - start_) },
+                { "dur", to_microseconds(s.end - s.start) },
+                { "pid", 0 },
+                { "tid", 0 },
+                { "args", { { "asset", a.name } } } });
+        }
+    }
+
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+
+    std::ofstream file(path);
+    file << nlohmann::json { { "traceEvents", j_events }, { "displayTimeUnit", "ms" } }.dump();
+}
+
+void profiler::read_trace(const std::filesystem::path& path)
+{
+    nlohmann::json j_trace;
+    std::ifstream file(path);
+    file >> j_trace;
+
+    // Assets carry their sizes, stages name the asset they belong to.
+    std::map<std::string, size_t> asset_indices;
+    const auto& j_events = j_trace.at("traceEvents");
+    for (const auto& j_event : j_events) {
+        const auto& j_args = j_event.at("args");
+        if (!j_args.contains("bytes_in"))
+            continue;
+
+        asset a;
+        a.name = j_event.at("name").get<std::string>();
+        a.type = j_event.at("cat").get<std::string>();
+        a.start = start_ + from_microseconds(j_event.at("ts").get<double>());
+        a.end = a.start + from_microseconds(j_event.at("dur").get<double>());
+        a.bytes_in = j_args.at("bytes_in").get<std::uintmax_t>();
+        a.bytes_out = j_args.at("bytes_out").get<std::uintmax_t>();
+        a.process_peak_rss = j_args.at("process_peak_rss").get<std::uintmax_t>();
+        asset_indices[a.name] = assets_.size();
+        assets_.push_back(std::move(a));
+    }
+
+    for (const auto& j_event : j_events) {
+        auto asset_j = j_event.at("args").find("asset");
+        if (asset_j == j_event.at("args").end())
+            continue;
+
+        auto it = asset_indices.find(asset_j->get<std::string>());
+        if (it == asset_indices.end())
+            continue;
+
+        span s;
+        s.name = j_event.at("name").get<std::string>();
+        s.start = start_ + from_microseconds(j_event.at("ts").get<double>());
+        s.end = s.start + from_microseconds(j_event.at("dur").get<double>());
+        assets_[it->second].stages.push_back(std::move(s));
+    }
+}
+
+void profiler::write_summary(std::ostream& os) const
+{
+    std::vector<const asset*> sorted;
+    for (const auto& a : assets_)
+        sorted.push_back(&a);
+    std::sort(sorted.begin(), sorted.end(), [](const asset* lhs, const asset* rhs) {
+        return (lhs->end - lhs->start) > (rhs->end - rhs->start);
+    });
+
+    // Resident memory can only be measured for the whole process, the proc
+    // column is the peak of the process that baked the asset.
+    os << std::fixed << std::setprecision(2);
+    os << std::setw(12) << "time (ms)" << std::setw(12) << "in (MB)" << std::setw(12) << "out (MB)" << std::setw(12) << "proc (MB)"
+       << "  " << std::left << std::setw(12) << "baker" << "asset" << std::right << '\n';
+    for (const auto* a : sorted) {
+        os << std::setw(12) << to_milliseconds(a->end - a->start)
+           << std::setw(12) << to_megabytes(a->bytes_in)
+           << std::setw(12) << to_megabytes(a->bytes_out)
+           << std::setw(12) << to_megabytes(a->process_peak_rss)
+           << "  " << std::left << std::setw(12) << a->type << a->name << std::right << '\n';
+
+        // Slowest stages first.
+        std::vector<const span*> stages;
+        for (const auto& s : a->stages)
+            stages.push_back(&s);
+        std::sort(stages.begin(), stages.end(), [](const span* lhs, const span* rhs) {
+            return (lhs->end - lhs->start) > (rhs->end - rhs->start);
+        });
+        for (const auto* s : stages)
+            os << std::setw(12) << to_milliseconds(s->end - s->start) << std::string(52, ' ') << "  " << s->name << '\n';
+    }
+
+    struct baker_totals {
+        clock::duration time = clock::duration::zero();
+        std::uintmax_t bytes_in = 0;
+        std::uintmax_t bytes_out = 0;
+        std::uintmax_t process_peak_rss = 0;
+    };
+
+    std::map<std::string, baker_totals> bakers;
+    for (const auto& a : assets_) {
+        auto& totals = bakers[a.type];
+        totals.time += a.end - a.start;
+        totals.bytes_in += a.bytes_in;
+        totals.bytes_out += a.bytes_out;
+        totals.process_peak_rss = std::max(totals.process_peak_rss, a.process_peak_rss);
+    }
+
+    std::vector<std::pair<std::string, baker_totals>> sorted_bakers(bakers.begin(), bakers.end());
+    std::sort(sorted_bakers.begin(), sorted_bakers.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.time > rhs.second.time;
+    });
+
+    os << '\n';
+    for (const auto& [type, totals] : sorted_bakers) {
+        os << std::setw(12) << to_milliseconds(totals.time)
+           << std::setw(12) << to_megabytes(totals.bytes_in)
+           << std::setw(12) << to_megabytes(totals.bytes_out)
+           << std::setw(12) << to_megabytes(totals.process_peak_rss)
+           << "  " << type << " (total)\n";
+    }
+}
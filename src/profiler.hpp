@@ -0,0 +1,84 @@
+#ifndef SIGMA_BAKE_PROFILER_HPP
+#define SIGMA_BAKE_PROFILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Records per asset and per stage timings of a sigma-bake run.
+//
+// The result can be written as Chrome trace events (chrome://tracing,
+// Perfetto) and as a summary table of the most expensive assets.
+class profiler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Times a stage of the current asset until it goes out of scope, does
+    // nothing without a profiler.
+    class scope {
+    public:
+        scope(profiler* owner, std::string name);
+
+        scope(const scope&) = delete;
+
+        scope& operator=(const scope&) = delete;
+
+        ~scope();
+
+    private:
+        profiler* owner_;
+        std::string name_;
+        clock::time_point start_;
+    };
+
+    profiler();
+
+    void begin_asset(const std::string& name);
+
+    // Type of resource baked by the current asset, used to group the summary
+    // per baker.
+    void set_asset_type(const std::string& type);
+
+    void end_asset(std::uintmax_t bytes_in, std::uintmax_t bytes_out);
+
+    void write_trace(const std::filesystem::path& path) const;
+
+    // Adds the assets of a trace written by another run, so one summary can
+    // cover a package baked by many processes.
+    void read_trace(const std::filesystem::path& path);
+
+    void write_summary(std::ostream& os) const;
+
+    // Total time spent in each stage over all assets.
+    std::map<std::string, clock::duration> stage_totals() const;
+
+private:
+    struct span {
+        std::string name;
+        clock::time_point start;
+        clock::time_point end;
+    };
+
+    struct asset {
+        std::string name;
+        std::string type;
+        clock::time_point start;
+        clock::time_point end;
+        std::uintmax_t bytes_in = 0;
+        std::uintmax_t bytes_out = 0;
+        // Peak resident set size of the whole process when the asset
+        // finished, it includes everything baked before it.
+        std::uintmax_t process_peak_rss = 0;
+        std::vector<span> stages;
+    };
+
+    clock::time_point start_;
+    bool in_asset_ = false;
+    std::vector<asset> assets_;
+};
+
+#endif // SIGMA_BAKE_PROFILER_HPP
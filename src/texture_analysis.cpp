@@ -0,0 +1,87 @@
+#include "texture_analysis.hpp"
+
+#include "parallel.hpp"
+
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIGMA_BAKE_SSE2
+#endif
+
+namespace {
+// Pixels are scanned in fixed size blocks spread over the cores.
+const std::size_t pixel_block_size = 1 << 16;
+
+texture_analysis analyze_block(const unsigned char* pixels, std::size_t pixel_count, std::uint32_t first)
+{
+    texture_analysis result;
+    std::size_t i = 0;
+
+#ifdef SIGMA_BAKE_SSE2
+    const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m128i first_pixel = _mm_set1_epi32(static_cast<int>(first));
+
+    __m128i opaque = _mm_set1_epi32(-1);
+    __m128i constant = _mm_set1_epi32(-1);
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * 4));
+
+        opaque = _mm_and_si128(opaque, _mm_cmpeq_epi32(_mm_and_si128(v, alpha_mask), alpha_mask));
+        constant = _mm_and_si128(constant, _mm_cmpeq_epi32(v, first_pixel));
+    }
+
+    result.opaque = _mm_movemask_epi8(opaque) == 0xFFFF;
+    result.constant = _mm_movemask_epi8(constant) == 0xFFFF;
+#endif
+
+    for (; i < pixel_count; ++i) {
+        const unsigned char* p = pixels + i * 4;
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+
+        result.opaque = result.opaque && p[3] == 255;
+        result.constant = result.constant && value == first;
+    }
+
+    return result;
+}
+}
+
+texture_analysis analyze_rgba8(const unsigned char* pixels, std::size_t pixel_count)
+{
+    texture_analysis result;
+    if (pixel_count == 0)
+        return result;
+
+    std::uint32_t first;
+    std::memcpy(&first, pixels, sizeof(first));
+
+    std::size_t block_count = (pixel_count + pixel_block_size - 1) / pixel_block_size;
+    std::vector<texture_analysis> blocks(block_count);
+    parallel_for(block_count, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t block = begin; block < end; ++block) {
+            std::size_t first_pixel = block * pixel_block_size;
+            std::size_t count = std::min(pixel_block_size, pixel_count - first_pixel);
+            blocks[block] = analyze_block(pixels + first_pixel * 4, count, first);
+        }
+    });
+
+    for (const auto& block : blocks) {
+        result.opaque = result.opaque && block.opaque;
+        result.constant = result.constant && block.constant;
+    }
+    return result;
+}
+
+void rgba8_to_rgb8(const unsigned char* rgba, unsigned char* rgb, std::size_t pixel_count)
+{
+    parallel_for(pixel_count, pixel_block_size, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            rgb[i * 3 + 0] = rgba[i * 4 + 0];
+            rgb[i * 3 + 1] = rgba[i * 4 + 1];
+            rgb[i * 3 + 2] = rgba[i * 4 + 2];
+        }
+    });
+}
@@ -0,0 +1,21 @@
+#ifndef SIGMA_BAKE_TEXTURE_ANALYSIS_HPP
+#define SIGMA_BAKE_TEXTURE_ANALYSIS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// What a scan over the decoded RGBA8 pixels of a texture found.
+struct texture_analysis {
+    // Every alpha value is 255.
+    bool opaque = true;
+
+    // Every pixel has the same value.
+    bool constant = true;
+};
+
+texture_analysis analyze_rgba8(const unsigned char* pixels, std::size_t pixel_count);
+
+// Drops the alpha channel, rgb has to hold 3 * pixel_count bytes.
+void rgba8_to_rgb8(const unsigned char* rgba, unsigned char* rgb, std::size_t pixel_count);
+
+#endif // SIGMA_BAKE_TEXTURE_ANALYSIS_HPP
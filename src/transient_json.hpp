@@ -0,0 +1,17 @@
+#ifndef SIGMA_BAKE_TRANSIENT_JSON_HPP
+#define SIGMA_BAKE_TRANSIENT_JSON_HPP
+
+#include "transient_memory.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// JSON parsed while baking an asset. Objects and arrays are allocated from
+// the current transient_memory_scope, strings still use std::allocator.
+using transient_json = nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double, transient_allocator>;
+
+#endif // SIGMA_BAKE_TRANSIENT_JSON_HPP
@@ -0,0 +1,98 @@
+#include "transient_memory.hpp"
+
+#include <cstring>
+
+namespace {
+thread_local std::pmr::memory_resource* current_resource = nullptr;
+
+// Every block remembers where it came from and how large it is, so it can be
+// freed and resized through the plain malloc style interface.
+struct alignas(alignof(std::max_align_t)) block_header {
+    std::pmr::memory_resource* resource;
+    std::size_t size;
+};
+
+block_header* header_of(void* ptr)
+{
+    return static_cast<block_header*>(ptr) - 1;
+}
+}
+
+transient_memory_resource::transient_memory_resource(std::size_t arena_size)
+    : buffer_(new std::byte[arena_size])
+    , arena_(buffer_.get(), arena_size)
+    , pool_({ 0, arena_size / 16 }, &arena_)
+{
+}
+
+void transient_memory_resource::release()
+{
+    pool_.release();
+    arena_.release();
+}
+
+void* transient_memory_resource::do_allocate(std::size_t size, std::size_t alignment)
+{
+    // The pool hands blocks above its largest size straight to the arena,
+    // which would keep them until the asset is finished.
+    if (size > pool_.options().largest_required_pool_block)
+        return std::pmr::new_delete_resource()->allocate(size, alignment);
+    return pool_.allocate(size, alignment);
+}
+
+void transient_memory_resource::do_deallocate(void* ptr, std::size_t size, std::size_t alignment)
+{
+    if (size > pool_.options().largest_required_pool_block)
+        std::pmr::new_delete_resource()->deallocate(ptr, size, alignment);
+    else
+        pool_.deallocate(ptr, size, alignment);
+}
+
+bool transient_memory_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+transient_memory_scope::transient_memory_scope(std::pmr::memory_resource* resource)
+    : previous_(current_resource)
+{
+    current_resource = resource;
+}
+
+transient_memory_scope::~transient_memory_scope()
+{
+    current_resource = previous_;
+}
+
+void* transient_allocate(std::size_t size)
+{
+    auto resource = current_resource ? current_resource : std::pmr::get_default_resource();
+    auto header = static_cast<block_header*>(resource->allocate(sizeof(block_header) + size, alignof(block_header)));
+    header->resource = resource;
+    header->size = size;
+    return header + 1;
+}
+
+void* transient_reallocate(void* ptr, std::size_t size)
+{
+    if (ptr == nullptr)
+        return transient_allocate(size);
+
+    auto header = header_of(ptr);
+    if (size <= header->size)
+        return ptr;
+
+    auto new_ptr = transient_allocate(size);
+    std::memcpy(new_ptr, ptr, header->size);
+    transient_deallocate(ptr);
+    return new_ptr;
+}
+
+void transient_deallocate(void* ptr)
+{
+    if (ptr == nullptr)
+        return;
+
+    auto header = header_of(ptr);
+    header->resource->deallocate(header, sizeof(block_header) + header->size, alignof(block_header));
+}
@@ -0,0 +1,95 @@
+#ifndef SIGMA_BAKE_TRANSIENT_MEMORY_HPP
+#define SIGMA_BAKE_TRANSIENT_MEMORY_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Memory for the transient data of one asset. Blocks up to the largest pool
+// block are pooled in an arena, freed blocks are reused while the asset is
+// baked and the arena is reset by release(). Larger blocks, like decoded
+// images, come from the heap and are returned as soon as they are freed.
+class transient_memory_resource : public std::pmr::memory_resource {
+public:
+    explicit transient_memory_resource(std::size_t arena_size);
+
+    transient_memory_resource(const transient_memory_resource&) = delete;
+
+    transient_memory_resource& operator=(const transient_memory_resource&) = delete;
+
+    // Drops every pooled block, the initial arena block is kept for the next asset.
+    void release();
+
+protected:
+    void* do_allocate(std::size_t size, std::size_t alignment) override;
+
+    void do_deallocate(void* ptr, std::size_t size, std::size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    std::unique_ptr<std::byte[]> buffer_;
+    std::pmr::monotonic_buffer_resource arena_;
+    std::pmr::unsynchronized_pool_resource pool_;
+};
+
+// Routes the allocations of code that can not take an allocator, like
+// stb_image, to the memory resource of the current bake job. Without a
+// transient_memory_scope the default resource is used.
+class transient_memory_scope {
+public:
+    explicit transient_memory_scope(std::pmr::memory_resource* resource);
+
+    transient_memory_scope(const transient_memory_scope&) = delete;
+
+    transient_memory_scope& operator=(const transient_memory_scope&) = delete;
+
+    ~transient_memory_scope();
+
+private:
+    std::pmr::memory_resource* previous_;
+};
+
+void* transient_allocate(std::size_t size);
+
+void* transient_reallocate(void* ptr, std::size_t size);
+
+void transient_deallocate(void* ptr);
+
+// Allocator for containers that take an allocator type but no instance, like
+// nlohmann::basic_json. Allocates through transient_allocate.
+template <class T>
+struct transient_allocator {
+    using value_type = T;
+
+    transient_allocator() = default;
+
+    template <class U>
+    transient_allocator(const transient_allocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t count)
+    {
+        return static_cast<T*>(transient_allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept
+    {
+        transient_deallocate(ptr);
+    }
+};
+
+template <class T, class U>
+bool operator==(const transient_allocator<T>&, const transient_allocator<U>&) noexcept
+{
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const transient_allocator<T>&, const transient_allocator<U>&) noexcept
+{
+    return false;
+}
+
+#endif // SIGMA_BAKE_TRANSIENT_MEMORY_HPP
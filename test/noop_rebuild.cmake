@@ -0,0 +1,64 @@
+# Bakes two identical textures, the second one is stored as a copy of the
+# first, and checks that building again after a bake has nothing to do and
+# that the copy is baked again once its source changes.
+
+function(run_checked)
+    execute_process(COMMAND ${ARGN}
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE output
+    )
+    if(NOT result EQUAL 0)
+        list(JOIN ARGN " " command)
+        message(FATAL_ERROR "'${command}' failed:\n${output}")
+    endif()
+    set(output "${output}" PARENT_SCOPE)
+endfunction()
+
+function(expect_no_work STEP)
+    run_checked(${CMAKE_COMMAND} --build "${BUILD_DIRECTORY}" --target noop -- -d explain)
+    if(NOT output MATCHES "no work to do")
+        message(FATAL_ERROR "Rebuild ${STEP} was not a no-op:\n${output}")
+    endif()
+endfunction()
+
+set(PACKAGE_DIRECTORY "${WORK_DIRECTORY}/package")
+set(BUILD_DIRECTORY "${WORK_DIRECTORY}/build")
+file(REMOVE_RECURSE "${WORK_DIRECTORY}")
+
+# A flat 2x2 Radiance HDR image, it only needs printable bytes.
+set(IMAGE "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 2 +X 2\nAAAAAAAAAAAAAAAA")
+file(WRITE "${PACKAGE_DIRECTORY}/a.hdr" "${IMAGE}")
+file(WRITE "${PACKAGE_DIRECTORY}/b.hdr" "${IMAGE}")
+
+file(WRITE "${WORK_DIRECTORY}/CMakeLists.txt" "
+cmake_minimum_required(VERSION 3.20)
+project(noop_rebuild NONE)
+
+add_executable(sigma-bake IMPORTED)
+set_target_properties(sigma-bake PROPERTIES IMPORTED_LOCATION \"${SIGMA_BAKE}\")
+
+include(\"${BAKE_CMAKE}\")
+add_package(noop PACKAGE_ROOT \"${PACKAGE_DIRECTORY}\" a.hdr b.hdr)
+")
+
+run_checked(${CMAKE_COMMAND} -S "${WORK_DIRECTORY}" -B "${BUILD_DIRECTORY}" -G Ninja "-DCMAKE_MAKE_PROGRAM=${NINJA_COMMAND}")
+run_checked(${CMAKE_COMMAND} --build "${BUILD_DIRECTORY}" --target noop)
+expect_no_work("after the first bake")
+
+# The duplicate now is newer than the stored content it is baked from.
+execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 1)
+file(TOUCH "${PACKAGE_DIRECTORY}/b.hdr")
+run_checked(${CMAKE_COMMAND} --build "${BUILD_DIRECTORY}" --target noop)
+expect_no_work("after baking a duplicate")
+
+# A brighter image, the flat one above decodes to black.
+file(WRITE "${PACKAGE_DIRECTORY}/b.hdr" "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 2 +X 2\n~~~~~~~~~~~~~~~~")
+run_checked(${CMAKE_COMMAND} --build "${BUILD_DIRECTORY}" --target noop)
+expect_no_work("after changing the duplicate")
+
+file(READ "${BUILD_DIRECTORY}/data/texture/a" A_CONTENT HEX)
+file(READ "${BUILD_DIRECTORY}/data/texture/b" B_CONTENT HEX)
+if(A_CONTENT STREQUAL B_CONTENT)
+    message(FATAL_ERROR "The changed duplicate still has the content of the original")
+endif()